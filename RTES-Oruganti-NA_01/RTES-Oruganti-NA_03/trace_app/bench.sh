@@ -0,0 +1,116 @@
+#!/bin/sh
+#
+# Headless benchmark of trace_app on native_posix or qemu_cortex_m3.
+#
+# Builds the task_model.h set once per point of the parameter matrix with
+# -DBENCH=1 (the set runs at boot, no shell input needed), runs it, and
+# appends every RESULT line of the console as CSV rows:
+#
+#   board,<parameters>,record,metric,value
+#
+# usage: ./bench.sh [-b native_posix|qemu_cortex_m3] [-o results.csv] [-t timeout_s] [-s set.h] [NAME=v1,v2,...]...
+#
+# Without NAME arguments the matrix is SCHED_MODE x MUTEX_PROTOCOL. Any macro
+# task_model.h wraps in #ifndef (TOTAL_TIME, SCHED_MODE, MUTEX_PROTOCOL) can
+# be a dimension, for example:
+#
+#   ./bench.sh -b qemu_cortex_m3 SCHED_MODE=SCHED_RM,SCHED_EDF TOTAL_TIME=4000,8000
+#
+# -s runs another set of four tasks: a header (absolute path) that defines
+# THREAD0..THREAD3 like task_model.h, and optionally TOTAL_TIME.
+#
+# Needs west and a Zephyr tree (ZEPHYR_BASE), as for the board build.
+
+BOARD=native_posix
+OUT=bench_results.csv
+TIMEOUT=120
+TASK_SET=""
+APP_DIR=$(cd "$(dirname "$0")" && pwd)
+
+while getopts "b:o:t:s:h" opt; do
+	case $opt in
+	b) BOARD=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	t) TIMEOUT=$OPTARG ;;
+	s) TASK_SET=$OPTARG ;;
+	*) sed -n '3,22p' "$0"; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+	set -- SCHED_MODE=SCHED_RM,SCHED_EDF MUTEX_PROTOCOL=LOCK_NONE,LOCK_PIP,LOCK_PCP,LOCK_SRP
+fi
+
+NAMES=""
+for dim in "$@"; do
+	NAMES="$NAMES,${dim%%=*}"
+done
+echo "board$NAMES,record,metric,value" > "$OUT"
+
+failed=0
+
+# run_point <defines> <csv values>: build, run and collect one point of the matrix
+run_point() {
+	dir="$APP_DIR/build/bench/$BOARD${TASK_SET:+-$(basename "$TASK_SET" .h)}-$(echo "$1" | tr ';=' '__')"
+	log="$dir.log"
+	mkdir -p "$APP_DIR/build/bench"
+
+	if ! west build -p auto -b "$BOARD" -d "$dir" "$APP_DIR" -- -DBENCH=1 "-DAPP_DEFINES=$1" "-DTASK_SET=$TASK_SET" > "$log" 2>&1; then
+		echo "build failed: $1 (see $log)" >&2
+		failed=$((failed + 1))
+		return
+	fi
+
+	if [ "$BOARD" = native_posix ]; then
+		timeout "$TIMEOUT" "$dir/zephyr/zephyr.exe" > "$log" 2>&1
+	else
+		# QEMU keeps running after the benchmark, stop it once BENCH_END is printed
+		setsid west build -d "$dir" -t run > "$log" 2>&1 &
+		pid=$!
+		waited=0
+		while ! grep -q BENCH_END "$log" && [ $waited -lt "$TIMEOUT" ] && kill -0 $pid 2>/dev/null; do
+			sleep 1
+			waited=$((waited + 1))
+		done
+		kill -- -$pid 2>/dev/null
+		wait $pid 2>/dev/null
+	fi
+
+	if ! grep -q BENCH_END "$log"; then
+		echo "run did not finish: $1 (see $log)" >&2
+		failed=$((failed + 1))
+		return
+	fi
+
+	# RESULT <record> key=value ... becomes one row per key
+	tr -d '\r' < "$log" | awk -v prefix="$BOARD,$2" '
+		$1 == "RESULT" {
+			for (i = 3; i <= NF; i++) {
+				split($i, kv, "=")
+				print prefix "," $2 "," kv[1] "," kv[2]
+			}
+		}' >> "$OUT"
+	echo "done: $1"
+}
+
+# every point of the matrix as "<defines>/<csv values>", the cartesian product of the dimensions
+points="/"
+for dim in "$@"; do
+	next=""
+	for p in $points; do
+		for v in $(echo "${dim#*=}" | tr ',' ' '); do
+			next="$next ${p%%/*};${dim%%=*}=$v/${p#*/},$v"
+		done
+	done
+	points=$next
+done
+
+for p in $points; do
+	defs=${p%%/*}
+	vals=${p#*/}
+	run_point "${defs#;}" "${vals#,}"
+done
+
+echo "results in $OUT, $failed failed points"
+[ $failed -eq 0 ]
@@ -14,103 +14,464 @@
 #include <drivers/uart.h>
 #include <ctype.h>
 #include "task_model.h"
+#include "workload.h"
+#include "evtrace.h"
+#include "rlock.h"
+#ifdef CONFIG_ARCH_POSIX
+#include <posix_board_if.h>
+#endif
 
 
 #define MY_STACK_SIZE 1024			//Stack size for each thread
+#define RT_HIST_BUCKETS 10			//Response time histogram buckets, each one tenth of the period
 
 
-K_THREAD_STACK_ARRAY_DEFINE(my_stack, NUM_THREADS, MY_STACK_SIZE);    //Creating an array of equally sized stacks
+K_THREAD_STACK_ARRAY_DEFINE(my_stack, MAX_THREADS, MY_STACK_SIZE);    //Stack pool, one equally sized slot per task of the active set
 
 
-struct k_mutex my_mutex[NUM_MUTEXES];		//Defining Mutexes
-struct k_thread my_thread_data[NUM_THREADS];	//Defining Threads
+struct rlock my_mutex[MAX_MUTEXES];		//Defining Mutexes, each with its own locking protocol
+struct k_thread my_thread_data[MAX_THREADS];	//Defining Threads
 struct k_timer main_timer;			//Defining Timer (for main thread)
-struct k_timer indv_timer;			//Defining Timers (for individual threads)
+struct k_timer indv_timer[MAX_THREADS];		//Defining Timers (deadline timer for each thread)
+struct k_timer release_timer[MAX_THREADS];	//Defining Timers (periodic release timer for each thread)
+struct k_sem release_sem[MAX_THREADS];		//Release signal from the release timer to its thread
 
-k_tid_t t_id_array[NUM_THREADS];			//Defining array thread id's as global variables
+k_tid_t t_id_array[MAX_THREADS];			//Defining array thread id's as global variables
+int t_idx_array[MAX_THREADS];				//Task index handed to each thread and deadline timer
+int created_threads;					//Number of threads created for the latest run
+volatile bool run_active;				//Set from activate until the main timer expires
+
+static const struct task_s default_threads[NUM_THREADS] = {THREAD0, THREAD1, THREAD2, THREAD3};	//Task set restored by "taskset default"
+static const enum lock_protocol default_proto[MAX_MUTEXES] = MUTEX_PROTOCOLS;				//and its mutex protocols
+static const char * const proto_names[LOCK_PROTOCOLS] = LOCK_PROTOCOL_NAMES;
+static const char * const sched_names[SCHED_MODES] = {"rm", "edf"};
+static const char * const overrun_names[OVR_POLICIES] = OVERRUN_POLICY_NAMES;
+enum sched_mode run_sched;				//Scheduling of the latest run
+int edf_prio;						//Common priority of all tasks under EDF
+
+struct task_stats					//Deadline monitor record for each task
+{
+	uint32_t releases;				// number of jobs released
+	uint32_t lost_releases;				// releases that found the previous one still pending
+	uint32_t started;				// number of jobs started
+	uint32_t completions;				// number of jobs completed
+	uint32_t met;					// jobs completed before the deadline timer expired
+	atomic_t misses;				// deadline timer expiries
+	uint32_t next_release_cyc;			// cycle count stamped by the release timer
+	uint32_t release_cyc;				// cycle count at the release of the current job
+	uint32_t completion_cyc;			// cycle count at the latest completion
+	uint32_t last_rt_us;				// latest response time in microseconds
+	uint32_t wcrt_us;				// worst case response time observed in microseconds
+	uint64_t sum_rt_us;				// sum of the response times, for the average
+	uint32_t max_lateness_us;			// largest completion past the deadline in microseconds
+	uint32_t min_jitter_us;				// smallest delay from release to job start in microseconds
+	uint32_t max_jitter_us;				// largest delay from release to job start in microseconds
+	uint64_t sum_jitter_us;				// sum of the release delays, for the average
+	uint32_t hist[RT_HIST_BUCKETS + 1];		// response time histogram, the last bucket is past the deadline
+	bool edf_refreshed;				// EDF: the release timer already set the deadline of the pending job
+	volatile bool job_active;			// from the start of a job until finish_job() ends it, completed or aborted
+	uint32_t overruns;				// jobs the overrun policy was applied to
+	uint32_t skipped;				// releases dropped by OVR_SKIP
+	uint32_t aborted;				// jobs stopped by OVR_ABORT
+	uint32_t demoted;				// jobs finished at DEMOTE_PRIO
+	uint32_t degraded;				// jobs run with DEGRADE_PERCENT of their work
+	uint32_t cascade_misses;			// misses while another task was overrunning
+	volatile bool skip_release;			// OVR_SKIP: drop the next release
+	volatile bool abort_job;			// OVR_ABORT: stop the current job
+	volatile bool demote_job;			// OVR_DEMOTE: lower the priority of the current job
+	bool job_demoted;				// the current job runs at DEMOTE_PRIO
+	int degrade_left;				// OVR_DEGRADE: jobs still to run degraded
+};
+
+struct task_stats t_stats[MAX_THREADS];		//Deadline monitor records
+atomic_t overrun_mask;					//Tasks whose current job is past its deadline, one bit each
+
+int burst_jobs[MAX_THREADS];				//Overload burst: jobs still to run inflated
+int burst_percent[MAX_THREADS];				//Overload burst: work of an inflated job in percent
+
+struct run_summary					//Per task results of the latest run under one scheduling mode
+{
+	int num_threads;				// 0 until a run under this mode finished
+	uint32_t util_permille;				// utilisation of the task set with the calibrated kernels
+	struct
+	{
+		char t_name[32];
+		int period;
+		uint32_t releases;
+		uint32_t completions;
+		uint32_t misses;
+		uint32_t avg_rt_us;
+		uint32_t wcrt_us;
+	} task[MAX_THREADS];
+};
+
+struct run_summary summary[SCHED_MODES];		//RM and EDF results side by side for "compare"
 
 
 
 extern void my_expiry_function(struct k_timer *timer_id)		//Main timer expiry function for TOTAL_TIME
 {
-	printk("Main timer has expired\n");
+	evtrace_log(EVT_RUN_END, EVT_NO_THREAD, 0);	//no printk in timer context, the trace is drained by a low priority thread
+
+	run_active = false;		//Deadline timers of jobs cut off here are no longer counted
 
-	for (int i = 0; i < NUM_THREADS; i++)
+	for (int i = 0; i < created_threads; i++)
 	{
-		printk("Putting %s to suspend\n", threads[i].t_name);
+		k_timer_stop(&release_timer[i]);		//No more releases after TOTAL_TIME
+		k_timer_stop(&indv_timer[i]);
+	}
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		evtrace_log(EVT_SUSPEND, i, 0);
 
 		k_thread_suspend(t_id_array[i]);		//Terminating all threads after main timer timeouts. 
 	}
 }
 
+extern void release_expiry_function(struct k_timer *release_timer_id)	// Expiry function for the periodic release timer
+{
+	int id = *(int *)k_timer_user_data_get(release_timer_id);
+	struct task_stats *st = &t_stats[id];
+
+	st->releases++;
+	evtrace_log(EVT_RELEASE, id, st->releases);
+
+	if (st->skip_release)
+	{
+		st->skip_release = false;
+		st->skipped++;			// the late job runs on without a release queued behind it
+		return;
+	}
+
+	if (k_sem_count_get(&release_sem[id]) > 0)
+	{
+		st->lost_releases++;		// previous release has not been picked up yet, keep its time stamp
+		return;
+	}
+
+	st->next_release_cyc = k_cycle_get_32();
+
+	if (run_sched == SCHED_EDF && !st->job_active)		// the task waits for this release, so its absolute
+	{								// deadline is one period from now
+		k_thread_deadline_set(t_id_array[id], (int)k_ms_to_cyc_ceil32(threads[id].period));
+		st->edf_refreshed = true;
+	}
+
+	k_sem_give(&release_sem[id]);
+}
+
+void handle_overrun(int id)			//Applies the overrun policy of a task to its job past the deadline
+{
+	struct task_stats *st = &t_stats[id];
+
+	if (atomic_get(&overrun_mask) & ~BIT(id))
+	{
+		st->cascade_misses++;		// another task's overrun may have caused this miss
+	}
+	atomic_set_bit(&overrun_mask, id);
+
+	st->overruns++;
+	evtrace_log(EVT_OVERRUN, id, threads[id].overrun);
+
+	switch (threads[id].overrun)
+	{
+	case OVR_SKIP:
+		st->skip_release = true;
+		break;
+	case OVR_ABORT:
+		st->abort_job = true;
+		break;
+	case OVR_DEMOTE:
+		st->demote_job = true;		// the task lowers its own priority, it may hold a ceiling lock now
+		break;
+	case OVR_DEGRADE:
+		st->degrade_left = DEGRADE_JOBS;
+		break;
+	default:
+		break;
+	}
+}
+
 extern void indv_expiry_function(struct k_timer *indv_timer_id)	// Expiry function for the individual timer. 
 {
-	printk("Deadline is missed\n");		//Printing error message once the deadline is missed. 
+	int id = *(int *)k_timer_user_data_get(indv_timer_id);
+
+	if (!run_active)
+	{
+		return;
+	}
+
+	atomic_inc(&t_stats[id].misses);
+	evtrace_log(EVT_DEADLINE_MISS, id, t_stats[id].started);	//the drain thread prints the error message for the missed deadline
+
+	handle_overrun(id);
 }
 
 extern void indv_stop_function(struct k_timer *indv_timer_id)	// timer stop function
 {
-	printk("Computation finished successfully\n");		// on successful calling of this function indicates, the computation is finished.
+	int id = *(int *)k_timer_user_data_get(indv_timer_id);
+
+	if (!run_active)
+	{
+		return;
+	}
+
+	t_stats[id].met++;		// the timer is only stopped while running when the job finished before its deadline
+	evtrace_log(EVT_DEADLINE_MET, id, t_stats[id].started);
 }
 
 
-void initialize_mutexes()			//Generic function for initializing mutexes based on NUM_MUTEXES
+void initialize_timers()			//Generic function for initializing the release and deadline timers based on num_threads
 {
-	for (int i = 0; i < NUM_MUTEXES; i++)
+	for (int i = 0; i < num_threads; i++)
 	{
-		k_mutex_init(&my_mutex[i]);	//initializing mutexes. 
-	}	
+		t_idx_array[i] = i;
+		memset(&t_stats[i], 0, sizeof(t_stats[i]));
+		t_stats[i].min_jitter_us = UINT32_MAX;
+		atomic_clear_bit(&overrun_mask, i);
+
+		k_sem_init(&release_sem[i], 0, 1);
+		k_timer_init(&release_timer[i], release_expiry_function, NULL);
+		k_timer_user_data_set(&release_timer[i], &t_idx_array[i]);
+
+		k_timer_init(&indv_timer[i], indv_expiry_function, indv_stop_function);
+		k_timer_user_data_set(&indv_timer[i], &t_idx_array[i]);
+	}
+}
+
+
+void record_release(int id)			//Marks the start of a job and arms its deadline timer
+{
+	struct task_stats *st = &t_stats[id];
+	uint32_t deadline_us = 1000U * threads[id].period;
+	uint32_t jitter_us;
+
+	st->release_cyc = st->next_release_cyc;		//the job is measured from its nominal release, not from its start
+	jitter_us = k_cyc_to_us_floor32(k_cycle_get_32() - st->release_cyc);
+	st->started++;
+	st->job_active = true;
+	evtrace_log(EVT_JOB_START, id, jitter_us);
+
+	if (run_sched == SCHED_EDF && !st->edf_refreshed)	// released while the previous job overran
+	{
+		int32_t left = (int32_t)(k_ms_to_cyc_ceil32(threads[id].period) - (k_cycle_get_32() - st->release_cyc));
+
+		k_thread_deadline_set(k_current_get(), left > 0 ? left : 0);
+		k_yield();			// a job with an earlier deadline may be ready
+	}
+	st->edf_refreshed = false;
+
+	st->sum_jitter_us += jitter_us;
+	if (jitter_us < st->min_jitter_us)
+	{
+		st->min_jitter_us = jitter_us;
+	}
+	if (jitter_us > st->max_jitter_us)
+	{
+		st->max_jitter_us = jitter_us;
+	}
+
+	if (jitter_us >= deadline_us)
+	{
+		atomic_inc(&st->misses);	//the deadline has passed before the job could even start
+		evtrace_log(EVT_DEADLINE_MISS, id, st->started);
+		handle_overrun(id);
+		return;
+	}
+
+	k_timer_start(&indv_timer[id], K_USEC(deadline_us - jitter_us), K_NO_WAIT);	//deadline is one period after the release
+}
+
+
+void record_completion(int id)			//Marks the end of a job and updates the response time statistics
+{
+	struct task_stats *st = &t_stats[id];
+	uint32_t deadline_us = 1000U * threads[id].period;
+	uint32_t rt_us;
+	uint32_t bucket;
+
+	k_timer_stop(&indv_timer[id]);
+
+	st->completion_cyc = k_cycle_get_32();
+	st->completions++;
+
+	rt_us = k_cyc_to_us_floor32(st->completion_cyc - st->release_cyc);	//unsigned difference handles the cycle counter wrap
+	st->last_rt_us = rt_us;
+	st->sum_rt_us += rt_us;
+	evtrace_log(EVT_JOB_END, id, rt_us);
+
+	if (rt_us > st->wcrt_us)
+	{
+		st->wcrt_us = rt_us;
+	}
+
+	if (rt_us > deadline_us && rt_us - deadline_us > st->max_lateness_us)
+	{
+		st->max_lateness_us = rt_us - deadline_us;
+	}
+
+	bucket = (uint32_t)(((uint64_t)rt_us * RT_HIST_BUCKETS) / deadline_us);
+	if (bucket > RT_HIST_BUCKETS)
+	{
+		bucket = RT_HIST_BUCKETS;
+	}
+	st->hist[bucket]++;
+}
+
+
+void initialize_mutexes()			//Generic function for initializing mutexes based on num_mutexes
+{
+	int ceiling[MAX_MUTEXES];
+
+	for (int i = 0; i < num_mutexes; i++)
+	{
+		ceiling[i] = K_LOWEST_APPLICATION_THREAD_PRIO;		//ceiling of a mutex no task uses
+	}
+
+	for (int i = 0; i < num_threads; i++)
+	{
+		if (threads[i].priority < ceiling[threads[i].mutex_m])
+		{
+			ceiling[threads[i].mutex_m] = threads[i].priority;	//highest priority (smallest number) of the users
+		}
+	}
+
+	rlock_init(my_mutex, num_mutexes, mutex_proto, ceiling);	//initializing mutexes. 
+}
+
+
+int job_scale(int id)				//Share of its work in percent the next job of a task runs
+{
+	struct task_stats *st = &t_stats[id];
+	int scale = 100;
+
+	if (burst_jobs[id] > 0)
+	{
+		burst_jobs[id]--;
+		scale = burst_percent[id];	// injected overload
+	}
+
+	if (st->degrade_left > 0)
+	{
+		st->degrade_left--;
+		st->degraded++;
+		scale = scale * DEGRADE_PERCENT / 100;
+	}
+
+	return scale;
+}
+
+
+bool compute(const struct task_s *t, int part, int id, int scale)	//Busy work emulating computation 1, 2 or 3 of a task, false when the job is aborted
+{
+	enum workload_kind kind = WORKLOAD_KIND(t->workload);
+	struct task_stats *st = &t_stats[id];
+	uint32_t total = (uint32_t)((uint64_t)t->loop_iter[part] * scale / 100);
+	uint32_t chunk = (t->workload & WORKLOAD_US) ? 1000 : MAX(workload_iter_per_ms(kind), 1);	// the overrun flags are checked about once per ms
+
+	for (uint32_t done = 0; done < total; done += chunk)
+	{
+		if (st->abort_job)
+		{
+			return false;
+		}
+
+		if (st->demote_job && part != 1)	// not inside the critical section, the lock protocol owns the priority there
+		{
+			st->demote_job = false;
+			st->job_demoted = true;
+			st->demoted++;
+			k_thread_priority_set(k_current_get(), DEMOTE_PRIO);
+		}
+
+		if (t->workload & WORKLOAD_US)
+		{
+			workload_run_us(kind, MIN(chunk, total - done));
+		}
+		else
+		{
+			workload_run(kind, MIN(chunk, total - done));
+		}
+	}
+
+	return true;
+}
+
+
+void finish_job(int id, bool done)		//Ends the job of a task, completed or aborted, and resets its overrun state
+{
+	struct task_stats *st = &t_stats[id];
+
+	if (done)
+	{
+		record_completion(id);		//stopping the deadline timer and recording the response time
+	}
+	else
+	{
+		st->aborted++;
+		evtrace_log(EVT_JOB_ABORT, id, st->started);
+	}
+
+	if (st->job_demoted)
+	{
+		st->job_demoted = false;
+		k_thread_priority_set(k_current_get(), run_sched == SCHED_EDF ? edf_prio : threads[id].priority);
+	}
+
+	st->job_active = false;
+	st->abort_job = false;
+	st->demote_job = false;			// a job that ended before it could be demoted
+	atomic_clear_bit(&overrun_mask, id);
 }
 
 
 void task_body(void *p1, void *p2, void *p3)		//Periodic task body.
 {	
 	struct task_s p = *(struct task_s *)p1;		//Pointer typecasting	
+	int id = *(int *)p2;				//Task index for the deadline monitor
+	int scale;					//Work of the current job in percent
+	bool done;					//The current job has not been aborted
 	
 	while (1)					//task body
 	{
+		k_sem_take(&release_sem[id], K_FOREVER);	//Thread waiting for the next release
+
+		rlock_job_start(p.priority);		//SRP: the job starts once its priority is above the system ceiling
+
 		//printk("%s has started the task\n", p.t_name);	//Debug statement
 		
-		k_timer_start(&indv_timer, K_MSEC(p.period), K_NO_WAIT);
+		record_release(id);			//starting the deadline timer of this task
 
 		//printk("Local timer started\n");			//Debug statement
 
-		volatile uint64_t n = p.loop_iter[0];
+		scale = job_scale(id);		//overload burst or degraded mode
 
 		//printk("Computation 1 (%s)\n", p.t_name);	//Debugging statement to check in console
 
-		while (n > 0)
-		{
-			n--;		//local computation 1 loop
-		}
+		done = compute(&p, 0, id, scale);	//local computation 1 loop
 
-	
-		k_mutex_lock(&my_mutex[p.mutex_m], K_FOREVER);	//locking corresponding mutex
+		if (done)
+		{
+			rlock_lock(&my_mutex[p.mutex_m]);	//locking corresponding mutex
+			evtrace_log(EVT_LOCK, id, p.mutex_m);
 
-		//printk("Computation 2 (%s)\n", p.t_name);	//Debugging statement to check in console
+			//printk("Computation 2 (%s)\n", p.t_name);	//Debugging statement to check in console
 
-		n = p.loop_iter[1];
+			done = compute(&p, 1, id, scale);	//local computation 2, an abort still releases the mutex
 
-		while (n > 0)
-		{
-			n--;		//local computation 2
+			evtrace_log(EVT_UNLOCK, id, p.mutex_m);
+			rlock_unlock(&my_mutex[p.mutex_m]);		//unlocking corresponding mutex
 		}
 
-
-		k_mutex_unlock(&my_mutex[p.mutex_m]);		//unlocking corresponding mutex
-
 		//printk("Computation 3 (%s)\n", p.t_name);	//Debugging statement to check in console
 
-		n = p.loop_iter[2];
-
-		while (n > 0)
+		if (done)
 		{
-			n--;		//local computation 3 
+			done = compute(&p, 2, id, scale);	//local computation 3 
 		}
 
-		k_msleep(p.period);		//Thread waiting for the period
-
-		k_timer_stop(&indv_timer);
+		finish_job(id, done);
 
 		//printk("%s has ended the task\n", p.t_name);	//Debug statement
 
@@ -121,40 +482,658 @@ void task_body(void *p1, void *p2, void *p3)		//Periodic task body.
 
 
 
+void destroy_threads()			//Aborts the threads of the previous run so their stack slots can be reused
+{
+	for (int i = 0; i < created_threads; i++)
+	{
+		k_thread_abort(t_id_array[i]);
+	}
+
+	created_threads = 0;
+}
+
+
 void create_threads()			//Generic function for creating threads
 {
-	for (int count = 0; count < NUM_THREADS; count++)
+	run_sched = sched_mode;
+	edf_prio = threads[0].priority;
+
+	for (int count = 1; count < num_threads; count++)
+	{
+		if (threads[count].priority < edf_prio)
+		{
+			edf_prio = threads[count].priority;	//EDF runs the whole set at its highest priority, deadlines decide
+		}
+	}
+
+	for (int count = 0; count < num_threads; count++)
 	{
 		t_id_array[count] = k_thread_create(&my_thread_data[count], my_stack[count],
                                  				MY_STACK_SIZE,
                                  				task_body,
-                                 				&threads[count],NULL, NULL,
-                                 				threads[count].priority, 0, K_FOREVER);		//Creating threads
+                                 				&threads[count], &t_idx_array[count], NULL,
+                                 				run_sched == SCHED_EDF ? edf_prio : threads[count].priority,
+                                 				0, K_FOREVER);		//Creating threads
 
 		k_thread_name_set(t_id_array[count], threads[count].t_name);	//Setting thread names (to view in SystemView)
+		evtrace_name_set(count, threads[count].t_name);			//and in the event trace
+	}
+
+	created_threads = num_threads;
+}
+
+
+
+uint32_t task_util_permille(const struct task_s *t)	//Utilisation of a task with the calibrated workload kernels
+{
+	uint64_t c_us = 0;
+
+	for (int part = 0; part < 3; part++)
+	{
+		if (t->workload & WORKLOAD_US)
+		{
+			c_us += t->loop_iter[part];
+		}
+		else
+		{
+			c_us += (uint64_t)t->loop_iter[part] * 1000U / MAX(workload_iter_per_ms(WORKLOAD_KIND(t->workload)), 1);
+		}
 	}
+
+	return (uint32_t)(c_us / t->period);		// us per ms is per mille
 }
 
 
+void save_summary()			//Keeps the results of the finished run for "compare"
+{
+	struct run_summary *sum = &summary[run_sched];
+
+	sum->num_threads = created_threads;
+	sum->util_permille = 0;
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		strcpy(sum->task[i].t_name, threads[i].t_name);
+		sum->task[i].period = threads[i].period;
+		sum->task[i].releases = st->releases;
+		sum->task[i].completions = st->completions;
+		sum->task[i].misses = (uint32_t)atomic_get(&st->misses);
+		sum->task[i].avg_rt_us = st->completions ? (uint32_t)(st->sum_rt_us / st->completions) : 0;
+		sum->task[i].wcrt_us = st->wcrt_us;
+		sum->util_permille += task_util_permille(&threads[i]);
+	}
+}
+
+
+void start_run();
 
 static int activate_threads(const struct shell *shell, size_t argc, char **argv)		//Shell command function
 {
  	ARG_UNUSED(argc);
 	ARG_UNUSED(argv);
 
-	k_timer_start(&main_timer, K_MSEC(TOTAL_TIME), K_NO_WAIT);			// starting timer for "total computation" 
+	if (run_active)
+	{
+		shell_error(shell, "A run is already in progress");
+		return -EBUSY;
+	}
+
+	if (num_threads == 0)
+	{
+		shell_error(shell, "The task set is empty");
+		return -EINVAL;
+	}
+
+	start_run();
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(activate, NULL, "Activate all threads", activate_threads);		//Registering shell command "activate" 
+
+
+void start_run()			//Sets up and starts a run of the current task set
+{
+	if (created_threads > 0)
+	{
+		save_summary();		// the previous run stays available to "compare"
+	}
+
+	destroy_threads();		// threads of the previous run are suspended, possibly holding a mutex
+	initialize_mutexes();		// so the mutexes are initialized again after they are gone
+	initialize_timers();
+	create_threads();
+
+	run_active = true;
+
+	k_timer_start(&main_timer, K_MSEC(total_time), K_NO_WAIT);			// starting timer for "total computation" 
 
 	printk("Main Timer Started\n");		//Debug statement
+	evtrace_log(EVT_RUN_START, EVT_NO_THREAD, total_time);
 
-	for(int i = 0; i < NUM_THREADS; i++)
+	for(int i = 0; i < num_threads; i++)
 	{
 		k_thread_start(t_id_array[i]);			// threads starting after shell command activate
 	}
 
+	for(int i = 0; i < num_threads; i++)
+	{
+		k_timer_start(&release_timer[i], K_NO_WAIT, K_MSEC(threads[i].period));	// first release now, then one every period
+	}
+}
+
+
+static int calibrate_loop(const struct shell *shell, size_t argc, char **argv)		//Shell command function
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	workload_init();		// timing again, e.g. after the clock or cache configuration changed
+
+	for (int kind = 0; kind < WL_KINDS; kind++)
+	{
+		shell_print(shell, "%-6s %10u iterations per ms", workload_name(kind), workload_iter_per_ms(kind));
+	}
+
 	return 0;
 }
 
-SHELL_CMD_REGISTER(activate, NULL, "Activate all threads", activate_threads);		//Registering shell command "activate" 
+SHELL_CMD_REGISTER(calibrate, NULL, "Measure the iterations per millisecond of every workload kernel",
+		   calibrate_loop);		//Registering shell command "calibrate"
+
+
+static int parse_int(const struct shell *shell, const char *arg, int min, int *val)	//Parses a decimal argument no smaller than min
+{
+	char *end;
+	long v = strtol(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0' || v < min || v > INT32_MAX)
+	{
+		shell_error(shell, "Invalid value: %s", arg);
+		return -EINVAL;
+	}
+
+	*val = (int)v;
+	return 0;
+}
+
+static int taskset_add(const struct shell *shell, size_t argc, char **argv)		//taskset add <name> <priority> <period> <c1> <c2> <c3> <mutex> [alu|mem|cache] [iter|us]
+{
+	struct task_s t;
+	int ret = 0;
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	if (num_threads >= MAX_THREADS)
+	{
+		shell_error(shell, "Task set is full (%d threads)", MAX_THREADS);
+		return -ENOMEM;
+	}
+
+	memset(&t, 0, sizeof(t));
+	strncpy(t.t_name, argv[1], sizeof(t.t_name) - 1);
+
+	ret |= parse_int(shell, argv[2], 0, &t.priority);
+	ret |= parse_int(shell, argv[3], 1, &t.period);
+	ret |= parse_int(shell, argv[4], 0, &t.loop_iter[0]);
+	ret |= parse_int(shell, argv[5], 0, &t.loop_iter[1]);
+	ret |= parse_int(shell, argv[6], 0, &t.loop_iter[2]);
+	ret |= parse_int(shell, argv[7], 0, &t.mutex_m);
+	if (ret != 0)
+	{
+		return -EINVAL;
+	}
+
+	if (t.mutex_m >= MAX_MUTEXES)
+	{
+		shell_error(shell, "Mutex id must be below %d", MAX_MUTEXES);
+		return -EINVAL;
+	}
+
+	if (argc > 8)
+	{
+		ret = workload_parse(argv[8]);
+		if (ret < 0)
+		{
+			shell_error(shell, "Unknown workload: %s", argv[8]);
+			return -EINVAL;
+		}
+		t.workload = ret;
+	}
+
+	if (argc > 9)
+	{
+		if (strcmp(argv[9], "us") == 0)
+		{
+			t.workload |= WORKLOAD_US;
+		}
+		else if (strcmp(argv[9], "iter") != 0)
+		{
+			shell_error(shell, "Unit must be iter or us: %s", argv[9]);
+			return -EINVAL;
+		}
+	}
+
+	threads[num_threads++] = t;
+
+	if (t.mutex_m >= num_mutexes)
+	{
+		num_mutexes = t.mutex_m + 1;
+	}
+
+	return 0;
+}
+
+static int taskset_clear(const struct shell *shell, size_t argc, char **argv)		//Empties the task set before new tasks are added
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	num_threads = 0;
+	num_mutexes = 0;
+
+	return 0;
+}
+
+static int taskset_default(const struct shell *shell, size_t argc, char **argv)		//Restores the task set of task_model.h
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	memcpy(threads, default_threads, sizeof(default_threads));
+	memcpy(mutex_proto, default_proto, sizeof(default_proto));
+	num_threads = NUM_THREADS;
+	num_mutexes = NUM_MUTEXES;
+	total_time = TOTAL_TIME;
+
+	return 0;
+}
+
+static int taskset_time(const struct shell *shell, size_t argc, char **argv)		//taskset time <ms>
+{
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	return parse_int(shell, argv[1], 1, &total_time);
+}
+
+static int taskset_mutex(const struct shell *shell, size_t argc, char **argv)		//taskset mutex <id> <none|pip|pcp|srp>
+{
+	int id;
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	if (parse_int(shell, argv[1], 0, &id) != 0)
+	{
+		return -EINVAL;
+	}
+
+	if (id >= MAX_MUTEXES)
+	{
+		shell_error(shell, "Mutex id must be below %d", MAX_MUTEXES);
+		return -EINVAL;
+	}
+
+	for (int p = 0; p < LOCK_PROTOCOLS; p++)
+	{
+		if (strcmp(argv[2], proto_names[p]) == 0)
+		{
+			mutex_proto[id] = p;
+			return 0;
+		}
+	}
+
+	shell_error(shell, "Unknown protocol: %s", argv[2]);
+	return -EINVAL;
+}
+
+static int find_task(const struct shell *shell, const char *name)	//Index of a task of the set by name
+{
+	for (int i = 0; i < num_threads; i++)
+	{
+		if (strcmp(threads[i].t_name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	shell_error(shell, "No task %s in the set", name);
+	return -ENOENT;
+}
+
+static int taskset_overrun(const struct shell *shell, size_t argc, char **argv)	//taskset overrun <name> <continue|skip|abort|demote|degrade>
+{
+	int id;
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	id = find_task(shell, argv[1]);
+	if (id < 0)
+	{
+		return id;
+	}
+
+	for (int p = 0; p < OVR_POLICIES; p++)
+	{
+		if (strcmp(argv[2], overrun_names[p]) == 0)
+		{
+			threads[id].overrun = p;
+			return 0;
+		}
+	}
+
+	shell_error(shell, "Unknown overrun policy: %s", argv[2]);
+	return -EINVAL;
+}
+
+static int taskset_show(const struct shell *shell, size_t argc, char **argv)		//Prints the active task set
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(shell, "%d threads, %d mutexes, %d ms, %s", num_threads, num_mutexes, total_time,
+		    sched_names[sched_mode]);
+
+	for (int i = 0; i < num_threads; i++)
+	{
+		shell_print(shell, "%-8s prio %3d period %6d %s %8d %8d %8d mutex %d %s %s", threads[i].t_name,
+			    threads[i].priority, threads[i].period,
+			    (threads[i].workload & WORKLOAD_US) ? "us  " : "iter", threads[i].loop_iter[0],
+			    threads[i].loop_iter[1], threads[i].loop_iter[2], threads[i].mutex_m,
+			    workload_name(WORKLOAD_KIND(threads[i].workload)), overrun_names[threads[i].overrun]);
+	}
+
+	for (int i = 0; i < num_mutexes; i++)
+	{
+		shell_print(shell, "mutex %d %s", i, proto_names[mutex_proto[i]]);
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(taskset_cmds,
+	SHELL_CMD_ARG(add, NULL,
+		      "Add a task: <name> <priority> <period> <c1> <c2> <c3> <mutex> [alu|mem|cache] [iter|us]",
+		      taskset_add, 8, 2),
+	SHELL_CMD(clear, NULL, "Remove all tasks", taskset_clear),
+	SHELL_CMD(default, NULL, "Restore the task set of task_model.h", taskset_default),
+	SHELL_CMD_ARG(time, NULL, "Set the total execution time: <ms>", taskset_time, 2, 0),
+	SHELL_CMD_ARG(mutex, NULL, "Set the locking protocol of a mutex: <id> <none|pip|pcp|srp>", taskset_mutex, 3, 0),
+	SHELL_CMD_ARG(overrun, NULL, "Set the overrun policy of a task: <name> <continue|skip|abort|demote|degrade>",
+		      taskset_overrun, 3, 0),
+	SHELL_CMD(show, NULL, "Print the task set", taskset_show),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(taskset, &taskset_cmds, "Load the task set used by activate", NULL);	//Registering shell command "taskset"
+
+
+static int print_stats(const struct shell *shell, size_t argc, char **argv)		//Shell command function
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(shell, "%-8s %8s %6s %8s %8s %8s %10s %10s %10s", "task", "released", "lost", "done",
+		    "met", "missed", "last(us)", "wcrt(us)", "late(us)");
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		shell_print(shell, "%-8s %8u %6u %8u %8u %8d %10u %10u %10u", threads[i].t_name,
+			    st->releases, st->lost_releases, st->completions, st->met,
+			    (int)atomic_get(&st->misses), st->last_rt_us, st->wcrt_us, st->max_lateness_us);
+	}
+
+	shell_print(shell, "\nRelease jitter, release to job start (us)");
+	shell_print(shell, "%-8s %10s %10s %10s", "task", "min", "avg", "max");
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		shell_print(shell, "%-8s %10u %10u %10u", threads[i].t_name,
+			    st->started ? st->min_jitter_us : 0,
+			    st->started ? (uint32_t)(st->sum_jitter_us / st->started) : 0,
+			    st->max_jitter_us);
+	}
+
+	shell_print(shell, "\nResponse time histogram (bucket = period/%d, last bucket past the deadline)",
+		    RT_HIST_BUCKETS);
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		shell_fprintf(shell, SHELL_NORMAL, "%-8s", threads[i].t_name);
+		for (int b = 0; b <= RT_HIST_BUCKETS; b++)
+		{
+			shell_fprintf(shell, SHELL_NORMAL, " %6u", st->hist[b]);
+		}
+		shell_fprintf(shell, SHELL_NORMAL, "\n");
+	}
+
+	shell_print(shell, "\nOverruns (cascade = misses while another task was overrunning)");
+	shell_print(shell, "%-8s %-8s %8s %8s %8s %8s %8s %8s", "task", "policy", "overruns", "skipped",
+		    "aborted", "demoted", "degraded", "cascade");
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		shell_print(shell, "%-8s %-8s %8u %8u %8u %8u %8u %8u", threads[i].t_name,
+			    overrun_names[threads[i].overrun], st->overruns, st->skipped, st->aborted, st->demoted,
+			    st->degraded, st->cascade_misses);
+	}
+
+	shell_print(shell, "\nMutexes (PCP blocking shows up as release jitter, the hold time bounds it)");
+	shell_print(shell, "%-5s %-5s %4s %8s %8s %10s %10s %10s", "mutex", "proto", "ceil", "locked", "blocked",
+		    "avg wait", "max wait", "max hold");
+
+	for (int i = 0; i < num_mutexes; i++)
+	{
+		struct rlock_stats *ls = &my_mutex[i].stats;
+
+		shell_print(shell, "%-5d %-5s %4d %8u %8u %10u %10u %10u", i, proto_names[my_mutex[i].proto],
+			    my_mutex[i].ceiling, ls->acquired, ls->blocked,
+			    ls->blocked ? (uint32_t)(ls->sum_wait_us / ls->blocked) : 0,
+			    ls->max_wait_us, ls->max_hold_us);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(stats, NULL, "Print deadline monitor statistics of all threads", print_stats);	//Registering shell command "stats"
+
+
+static int overload_burst(const struct shell *shell, size_t argc, char **argv)	//burst <name> <percent> <jobs>
+{
+	int id, percent, jobs;
+
+	id = find_task(shell, argv[1]);
+	if (id < 0)
+	{
+		return id;
+	}
+
+	if (parse_int(shell, argv[2], 1, &percent) != 0 || parse_int(shell, argv[3], 0, &jobs) != 0)
+	{
+		return -EINVAL;
+	}
+
+	burst_percent[id] = percent;
+	burst_jobs[id] = jobs;		// taken up by the next jobs of the task, in this run or the next one
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(burst, NULL, "Run the next jobs of a task with more work: <name> <percent> <jobs>",
+		       overload_burst, 4, 0);
+
+
+static int set_sched(const struct shell *shell, size_t argc, char **argv)		//sched [rm|edf]
+{
+	if (argc == 1)
+	{
+		shell_print(shell, "%s", sched_names[sched_mode]);
+		return 0;
+	}
+
+	if (run_active)
+	{
+		shell_error(shell, "A run is in progress");
+		return -EBUSY;
+	}
+
+	for (int m = 0; m < SCHED_MODES; m++)
+	{
+		if (strcmp(argv[1], sched_names[m]) == 0)
+		{
+			sched_mode = m;
+			return 0;
+		}
+	}
+
+	shell_error(shell, "Expected rm or edf");
+	return -EINVAL;
+}
+
+SHELL_CMD_ARG_REGISTER(sched, NULL, "Schedule the next run with fixed priorities or EDF: [rm|edf]", set_sched, 1, 1);
+
+
+static int print_compare(const struct shell *shell, size_t argc, char **argv)		//RM and EDF results side by side
+{
+	const struct run_summary *rm = &summary[SCHED_RM];
+	const struct run_summary *edf = &summary[SCHED_EDF];
+	static const uint16_t rm_bound_permille[MAX_THREADS] = {1000, 828, 780, 757, 743, 735, 729, 724, 721, 718};	// n(2^(1/n) - 1)
+	int n;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!run_active && created_threads > 0)
+	{
+		save_summary();		// include the run that just finished
+	}
+
+	n = MAX(rm->num_threads, edf->num_threads);
+	if (n == 0)
+	{
+		shell_error(shell, "No finished run yet");
+		return -ENOENT;
+	}
+
+	shell_print(shell, "U = %u.%03u (rm), %u.%03u (edf), RM bound for %d tasks 0.%03u, EDF bound 1.000",
+		    rm->util_permille / 1000, rm->util_permille % 1000, edf->util_permille / 1000,
+		    edf->util_permille % 1000, n, rm_bound_permille[n - 1]);
+	shell_print(shell, "%-8s %6s | %8s %10s %10s | %8s %10s %10s", "task", "T(ms)", "rm miss%", "avg(us)",
+		    "wcrt(us)", "edf miss%", "avg(us)", "wcrt(us)");
+
+	for (int i = 0; i < n; i++)
+	{
+		const struct run_summary *any = i < rm->num_threads ? rm : edf;
+		uint32_t rm_pm = 0, edf_pm = 0;
+
+		if (i < rm->num_threads && rm->task[i].releases)
+		{
+			rm_pm = rm->task[i].misses * 1000U / rm->task[i].releases;
+		}
+		if (i < edf->num_threads && edf->task[i].releases)
+		{
+			edf_pm = edf->task[i].misses * 1000U / edf->task[i].releases;
+		}
+
+		shell_print(shell, "%-8s %6d | %6u.%u %10u %10u | %7u.%u %10u %10u", any->task[i].t_name,
+			    any->task[i].period, rm_pm / 10, rm_pm % 10,
+			    i < rm->num_threads ? rm->task[i].avg_rt_us : 0, i < rm->num_threads ? rm->task[i].wcrt_us : 0,
+			    edf_pm / 10, edf_pm % 10,
+			    i < edf->num_threads ? edf->task[i].avg_rt_us : 0, i < edf->num_threads ? edf->task[i].wcrt_us : 0);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(compare, NULL, "Print the latest RM and EDF runs side by side", print_compare);
+
+#ifdef BENCH_RUN
+void bench_run()			//Headless run of the task_model.h set for bench.sh, results as RESULT lines
+{
+	printk("BENCH_START\n");
+
+	start_run();
+	k_msleep(total_time);
+
+	while (run_active)
+	{
+		k_msleep(10);
+	}
+	k_msleep(200);				// let the trace drain thread (100 ms period) print the last misses first
+
+	save_summary();
+	printk("RESULT set sched=%s util_permille=%u threads=%d total_ms=%d\n", sched_names[run_sched],
+	       summary[run_sched].util_permille, created_threads, total_time);
+
+	for (int i = 0; i < created_threads; i++)
+	{
+		struct task_stats *st = &t_stats[i];
+
+		printk("RESULT %s released=%u lost=%u done=%u missed=%d avg_rt_us=%u wcrt_us=%u max_jitter_us=%u "
+		       "overruns=%u aborted=%u cascade=%u\n", threads[i].t_name, st->releases, st->lost_releases,
+		       st->completions, (int)atomic_get(&st->misses), summary[run_sched].task[i].avg_rt_us,
+		       st->wcrt_us, st->max_jitter_us, st->overruns, st->aborted, st->cascade_misses);
+	}
+
+	for (int i = 0; i < num_mutexes; i++)
+	{
+		struct rlock_stats *ls = &my_mutex[i].stats;
+
+		printk("RESULT mutex%d proto=%s locked=%u blocked=%u max_wait_us=%u max_hold_us=%u\n", i,
+		       proto_names[my_mutex[i].proto], ls->acquired, ls->blocked, ls->max_wait_us, ls->max_hold_us);
+	}
+
+	printk("BENCH_END\n");
+
+#ifdef CONFIG_ARCH_POSIX
+	posix_exit(0);			// native_posix: end the process, bench.sh reads its output
+#endif
+}
+#endif // BENCH_RUN
+
 
 void main()	//Main function.
 {
@@ -163,10 +1142,13 @@ void main()	//Main function.
 
 	printk("Please enter activate to start the threads.\n");	//Debug statement. 
 
-	initialize_mutexes();		//calling generic mutex initialization function.
-
 	k_timer_init(&main_timer, my_expiry_function, NULL);		//initializing the main timer for total computation
-	k_timer_init(&indv_timer, indv_expiry_function, indv_stop_function);	//initializing the individual timers for deadline check
 
-	create_threads();	//calling a generic thread create function.
+	workload_init();		//timing the busy work kernels before any task runs
+
+	//mutexes, deadline timers and threads are set up by "activate" for the task set loaded at that time
+
+#ifdef BENCH_RUN
+	bench_run();
+#endif
 }
\ No newline at end of file
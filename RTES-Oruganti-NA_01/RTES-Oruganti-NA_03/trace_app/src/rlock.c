@@ -0,0 +1,169 @@
+/*
+ * Resource locks with a locking protocol per lock, see rlock.h.
+ *
+ * The SRP system ceiling is a stack: every SRP lock pushes the higher of
+ * its own ceiling and the current system ceiling, so the top is always the
+ * system ceiling. Jobs that may not start wait on a condition variable that
+ * is broadcast whenever an SRP lock is released.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#define TASK_MODEL_TYPES_ONLY		// the task set variables are defined by main.c
+#include "rlock.h"
+
+static struct k_mutex srp_mutex;		// protects the SRP ceiling stack
+static struct k_condvar srp_cond;		// jobs waiting for the system ceiling to drop
+static struct rlock *srp_stack[MAX_MUTEXES];	// SRP locks held, innermost last
+static int srp_ceiling[MAX_MUTEXES];		// system ceiling while srp_stack[i] is held
+static int srp_depth;
+static bool srp_used;				// no SRP lock in the set, rlock_job_start() returns at once
+
+static void account_wait(struct rlock *l, uint32_t start_cyc)
+{
+	uint32_t wait_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+
+	l->stats.blocked++;
+	l->stats.sum_wait_us += wait_us;
+	if (wait_us > l->stats.max_wait_us)
+	{
+		l->stats.max_wait_us = wait_us;
+	}
+}
+
+void rlock_init(struct rlock *locks, int n, const enum lock_protocol *proto, const int *ceiling)
+{
+	srp_used = false;
+	srp_depth = 0;
+	k_mutex_init(&srp_mutex);
+	k_condvar_init(&srp_cond);
+
+	for (int i = 0; i < n; i++)
+	{
+		struct rlock *l = &locks[i];
+
+		memset(&l->stats, 0, sizeof(l->stats));
+		l->proto = proto[i];
+		l->ceiling = ceiling[i];
+		k_mutex_init(&l->mutex);
+		k_sem_init(&l->sem, 1, 1);
+
+		if (l->proto == LOCK_SRP)
+		{
+			srp_used = true;
+		}
+	}
+}
+
+void rlock_job_start(int prio)		// SRP: wait until prio is above the system ceiling
+{
+	struct rlock *l;
+	uint32_t start_cyc;
+
+	if (!srp_used)
+	{
+		return;
+	}
+
+	k_mutex_lock(&srp_mutex, K_FOREVER);
+
+	if (srp_depth > 0 && prio >= srp_ceiling[srp_depth - 1])
+	{
+		l = srp_stack[srp_depth - 1];		// the wait is charged to the lock that set the ceiling
+		start_cyc = k_cycle_get_32();
+
+		while (srp_depth > 0 && prio >= srp_ceiling[srp_depth - 1])
+		{
+			k_condvar_wait(&srp_cond, &srp_mutex, K_FOREVER);
+		}
+
+		account_wait(l, start_cyc);
+	}
+
+	k_mutex_unlock(&srp_mutex);
+}
+
+void rlock_lock(struct rlock *l)
+{
+	uint32_t start_cyc = k_cycle_get_32();
+	bool busy;
+
+	switch (l->proto)
+	{
+	case LOCK_NONE:
+		busy = k_sem_take(&l->sem, K_NO_WAIT) != 0;
+		if (busy)
+		{
+			k_sem_take(&l->sem, K_FOREVER);
+		}
+		break;
+	case LOCK_PCP:
+		l->saved_prio = k_thread_priority_get(k_current_get());
+		if (l->ceiling < l->saved_prio)
+		{
+			k_thread_priority_set(k_current_get(), l->ceiling);
+		}
+		/* fall through */
+	case LOCK_PIP:
+	default:
+		busy = k_mutex_lock(&l->mutex, K_NO_WAIT) != 0;		// never busy under PCP and SRP unless the ceiling is wrong
+		if (busy)
+		{
+			k_mutex_lock(&l->mutex, K_FOREVER);
+		}
+		break;
+	case LOCK_SRP:
+		busy = k_mutex_lock(&l->mutex, K_NO_WAIT) != 0;
+		if (busy)
+		{
+			k_mutex_lock(&l->mutex, K_FOREVER);
+		}
+
+		k_mutex_lock(&srp_mutex, K_FOREVER);
+		srp_ceiling[srp_depth] = (srp_depth > 0 && srp_ceiling[srp_depth - 1] < l->ceiling) ?
+					 srp_ceiling[srp_depth - 1] : l->ceiling;
+		srp_stack[srp_depth++] = l;
+		k_mutex_unlock(&srp_mutex);
+		break;
+	}
+
+	if (busy)
+	{
+		account_wait(l, start_cyc);
+	}
+
+	l->stats.acquired++;
+	l->lock_cyc = k_cycle_get_32();
+}
+
+void rlock_unlock(struct rlock *l)
+{
+	uint32_t hold_us = k_cyc_to_us_floor32(k_cycle_get_32() - l->lock_cyc);
+
+	if (hold_us > l->stats.max_hold_us)
+	{
+		l->stats.max_hold_us = hold_us;
+	}
+
+	switch (l->proto)
+	{
+	case LOCK_NONE:
+		k_sem_give(&l->sem);
+		break;
+	case LOCK_PCP:
+		k_mutex_unlock(&l->mutex);
+		k_thread_priority_set(k_current_get(), l->saved_prio);	// may switch to a task that was held back
+		break;
+	case LOCK_SRP:
+		k_mutex_unlock(&l->mutex);		// before the waiters are woken, they may use this lock
+		k_mutex_lock(&srp_mutex, K_FOREVER);
+		srp_depth--;				// locks are released in LIFO order
+		k_condvar_broadcast(&srp_cond);
+		k_mutex_unlock(&srp_mutex);
+		break;
+	case LOCK_PIP:
+	default:
+		k_mutex_unlock(&l->mutex);
+		break;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef __RLOCK_H__
+#define __RLOCK_H__
+
+/*
+ * Resource locks of the task set, one locking protocol per lock.
+ *
+ * LOCK_NONE	binary semaphore, the owner keeps its priority.
+ * LOCK_PIP	k_mutex, the owner inherits the priority of the waiters
+ *		(needs CONFIG_PRIORITY_CEILING below the task priorities).
+ * LOCK_PCP	immediate priority ceiling: the owner runs at the ceiling,
+ *		the highest priority of the tasks using the lock.
+ * LOCK_SRP	stack resource policy: a job only starts when its priority is
+ *		above the system ceiling of the SRP locks held, so it never
+ *		blocks once it runs. Tasks call rlock_job_start() on release.
+ *
+ * Under PCP a blocked task is simply not scheduled, so its blocking shows up
+ * as release jitter in the task statistics; the lock records the hold time
+ * that bounds it. Under PIP, NONE and SRP the wait is recorded by the lock.
+ */
+
+#include <zephyr.h>
+#include "task_model.h"
+
+struct rlock_stats
+{
+	uint32_t acquired;		// number of lock operations
+	uint32_t blocked;		// lock operations or SRP job starts that had to wait
+	uint64_t sum_wait_us;		// total wait, for the average
+	uint32_t max_wait_us;		// longest wait
+	uint32_t max_hold_us;		// longest critical section
+};
+
+struct rlock
+{
+	enum lock_protocol proto;
+	int ceiling;			// highest priority (smallest number) of the tasks using the lock
+	struct k_mutex mutex;		// PIP, PCP and SRP
+	struct k_sem sem;		// NONE
+	int saved_prio;			// PCP: priority of the owner before it was raised to the ceiling
+	uint32_t lock_cyc;		// cycle count at the acquisition, for the hold time
+	struct rlock_stats stats;
+};
+
+void rlock_init(struct rlock *locks, int n, const enum lock_protocol *proto, const int *ceiling);
+void rlock_lock(struct rlock *l);
+void rlock_unlock(struct rlock *l);
+void rlock_job_start(int prio);
+
+#endif // __RLOCK_H__
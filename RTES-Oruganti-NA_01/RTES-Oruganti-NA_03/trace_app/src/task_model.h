@@ -5,9 +5,18 @@
  * 
  */
 
+#ifdef TASK_SET_FILE			// bench.sh -s: header with THREAD0..THREAD3 (and TOTAL_TIME) of another set, see tools/rta_check.sh
+#include TASK_SET_FILE
+#endif
+
 #define NUM_MUTEXES 3		// number of mutexes
 #define NUM_THREADS	4		// number of threads
+#ifndef TOTAL_TIME			// bench.sh may override TOTAL_TIME, SCHED_MODE and MUTEX_PROTOCOL per build
 #define TOTAL_TIME 4000  	// total execution time in milliseconds
+#endif
+
+#define MAX_MUTEXES 8		// most mutexes a task set loaded from the shell may use
+#define MAX_THREADS 10		// most threads a task set loaded from the shell may have
 
 struct task_s
 {
@@ -16,14 +25,74 @@ struct task_s
 	int period; 		// period for periodic task in milliseconds
 	int loop_iter[3]; 	// loop iterations for compute_1, compute_2 and compute_3
 	int mutex_m; 		// the mutex id to be locked and unlocked by the task
+	int workload;		// busy work kernel (enum workload_kind), | WORKLOAD_US when loop_iter holds microseconds
+	int overrun;		// what a job does once it has missed its deadline (enum overrun_policy)
+};
+
+enum lock_protocol		// locking protocol of a mutex, see rlock.h
+{
+	LOCK_NONE,		// plain binary semaphore, no priority boosting
+	LOCK_PIP,		// priority inheritance (k_mutex)
+	LOCK_PCP,		// immediate priority ceiling
+	LOCK_SRP,		// stack resource policy, blocking at job start
+	LOCK_PROTOCOLS
+};
+
+#define LOCK_PROTOCOL_NAMES {"none", "pip", "pcp", "srp"}
+
+enum sched_mode			// scheduling of the periodic task set
+{
+	SCHED_RM,		// fixed priorities of the task set
+	SCHED_EDF,		// earliest deadline first among equal priorities (CONFIG_SCHED_DEADLINE)
+	SCHED_MODES
+};
+
+#ifndef SCHED_MODE
+#define SCHED_MODE SCHED_RM	// scheduling of the task set at boot, "sched" on the shell switches it
+#endif
+
+enum overrun_policy		// reaction of a task to a job past its deadline
+{
+	OVR_CONTINUE,		// finish the job, the next release waits for it
+	OVR_SKIP,		// finish the job and drop the next release
+	OVR_ABORT,		// stop the job (outside its critical section)
+	OVR_DEMOTE,		// finish the job at DEMOTE_PRIO, below all tasks
+	OVR_DEGRADE,		// run the next DEGRADE_JOBS jobs with DEGRADE_PERCENT of their work
+	OVR_POLICIES
 };
 
+#define OVERRUN_POLICY_NAMES {"continue", "skip", "abort", "demote", "degrade"}
+
+#define DEMOTE_PRIO 13		// priority of a demoted job, above the trace drain thread only
+#define DEGRADE_JOBS 4		// jobs run in degraded mode after a miss
+#define DEGRADE_PERCENT 50	// share of the work done by a degraded job
+
+#define WORKLOAD_US 0x100				// loop_iter is an execution time in microseconds
+#define WORKLOAD_KIND(w) ((w) & 0xff)			// kernel part of the workload field
+
+#ifndef THREAD0
 #define THREAD0 {"task00", 2, 50, {400000, 400000, 400000}, 1}
 #define THREAD1 {"task11", 3, 160, {800000, 900000, 800000}, 0}
 #define THREAD2 {"task22", 4, 220, {200000, 2000000, 400000}, 1}
 #define THREAD3 {"task33", 5, 360, {200000, 2000000, 400000}, 2}
+#endif
+
+#ifndef MUTEX_PROTOCOL
+#define MUTEX_PROTOCOL LOCK_NONE
+#endif
+#define MUTEX_PROTOCOLS {MUTEX_PROTOCOL, MUTEX_PROTOCOL, MUTEX_PROTOCOL}	// protocol of mutex 0..NUM_MUTEXES-1, the rest are LOCK_NONE
+
+
+#ifndef TASK_MODEL_TYPES_ONLY		// host tools that only need struct task_s and the THREADn initialisers define this
+
+struct task_s threads[MAX_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
 
+int num_threads = NUM_THREADS;		// number of threads in the active task set
+int num_mutexes = NUM_MUTEXES;		// number of mutexes in the active task set
+int total_time = TOTAL_TIME;		// total execution time of the active task set in milliseconds
+enum lock_protocol mutex_proto[MAX_MUTEXES] = MUTEX_PROTOCOLS;	// locking protocol of every mutex of the active task set
+enum sched_mode sched_mode = SCHED_MODE;			// scheduling of the next run
 
-struct task_s threads[NUM_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
+#endif // TASK_MODEL_TYPES_ONLY
 
 #endif // __TASK_MODEL_H__
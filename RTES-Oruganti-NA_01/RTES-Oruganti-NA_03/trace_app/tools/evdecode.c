@@ -0,0 +1,262 @@
+/*
+ * Host side decoder for the event trace of trace_app (and project_4).
+ *
+ * Reads a captured console log after "trace stream on": the EVTHZ and
+ * EVTNAME header lines and one "EVT <timestamp> <event> <thread> <arg>"
+ * line per record. Other console lines are ignored, so the whole log can
+ * be fed in. The 32 bit cycle timestamps are unwrapped, so runs longer
+ * than one counter period decode correctly as long as no gap between two
+ * records is longer than that.
+ *
+ * Default output is a per-job timeline as CSV (task, job, release, start
+ * and end in ms from the first record, response time, deadline miss;
+ * an aborted job has no response time),
+ * followed by a per-task summary on stderr. Aperiodic requests of
+ * project_4 (REQ_ARRIVAL to REQ_DONE) are summarised as well. With -r every
+ * record is printed decoded instead.
+ *
+ * Build: gcc -O2 -o evdecode tools/evdecode.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "../../../../common/evtrace.h"
+
+#define EVT_NAME(name) #name,
+
+static const char * const evt_names[EVT_COUNT] = { EVT_LIST(EVT_NAME) };
+
+struct job_track
+{
+	char t_name[32];	// from EVTNAME, "thread<n>" until then
+	uint32_t job;		// number of the open job, 0 when none
+	double release_ms;	// nominal release of the open job
+	double start_ms;	// start of the open job
+	int missed;		// a DEADLINE_MISS was logged for the open job
+	uint32_t jobs;		// completed jobs
+	uint32_t misses;	// deadline misses, including jobs cut off by the end of the run
+	uint32_t aborted;	// jobs stopped by the abort overrun policy
+	uint32_t wcrt_us;	// largest response time
+	uint64_t sum_rt_us;	// for the average response time
+};
+
+#define REQ_WINDOW 256		// requests in flight that can be matched, a power of two
+
+static struct job_track track[EVT_MAX_THREADS];
+static double req_arrival_ms[REQ_WINDOW];	// indexed by request id
+static unsigned long req_done;
+static double req_sum_ms, req_max_ms;
+
+static const char *thread_name(unsigned thread)
+{
+	if (thread < EVT_MAX_THREADS)
+	{
+		return track[thread].t_name;
+	}
+
+	return "-";
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-r] [-z cycles_per_sec] [console_log|-]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	double hz = 0.0;
+	uint64_t now = 0;		// unwrapped timestamp of the last record
+	uint32_t last_ts = 0;
+	uint64_t first = 0;
+	int have_first = 0;
+	int raw = 0;
+	unsigned long records = 0;
+	char line[256];
+	FILE *f = stdin;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "rz:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': raw = 1; break;
+		case 'z': hz = atof(optarg); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+
+	if (optind < argc && strcmp(argv[optind], "-") != 0)
+	{
+		f = fopen(argv[optind], "r");
+		if (!f)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < EVT_MAX_THREADS; i++)
+	{
+		snprintf(track[i].t_name, sizeof(track[i].t_name), "thread%d", i);
+	}
+
+	if (raw)
+	{
+		printf("time_ms,event,task,arg\n");
+	}
+	else
+	{
+		printf("task,job,release_ms,start_ms,end_ms,response_us,missed\n");
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		const char *p = strstr(line, "EVT");	// console prefixes (shell prompt, timestamps) are skipped
+		unsigned ts, event, thread, arg;
+		int id;
+		char name[32];
+		double t_ms;
+		struct job_track *jt;
+
+		if (!p)
+		{
+			continue;
+		}
+
+		if (sscanf(p, "EVTHZ %lf", &hz) == 1)
+		{
+			continue;
+		}
+
+		if (sscanf(p, "EVTNAME %d %31s", &id, name) == 2)
+		{
+			if (id >= 0 && id < EVT_MAX_THREADS)
+			{
+				strcpy(track[id].t_name, name);
+			}
+			continue;
+		}
+
+		if (sscanf(p, "EVT %x %x %x %x", &ts, &event, &thread, &arg) != 4 || event >= EVT_COUNT)
+		{
+			continue;
+		}
+
+		if (hz <= 0.0)
+		{
+			fprintf(stderr, "no EVTHZ line before the first record, give the cycle rate with -z\n");
+			return 1;
+		}
+
+		now += (uint32_t)(ts - last_ts);	// unsigned difference handles the cycle counter wrap
+		last_ts = ts;
+		if (!have_first)
+		{
+			first = now = ts;
+			have_first = 1;
+		}
+		t_ms = (now - first) * 1000.0 / hz;
+		records++;
+
+		if (raw)
+		{
+			printf("%.3f,%s,%s,%u\n", t_ms, evt_names[event], thread_name(thread), arg);
+			continue;
+		}
+
+		if (event == EVT_REQ_ARRIVAL)
+		{
+			req_arrival_ms[arg & (REQ_WINDOW - 1)] = t_ms;
+			continue;
+		}
+		if (event == EVT_REQ_DONE)
+		{
+			double rt_ms = t_ms - req_arrival_ms[arg & (REQ_WINDOW - 1)];
+
+			req_done++;
+			req_sum_ms += rt_ms;
+			if (rt_ms > req_max_ms)
+			{
+				req_max_ms = rt_ms;
+			}
+			continue;
+		}
+
+		if (event == EVT_RUN_START)
+		{
+			for (int i = 0; i < EVT_MAX_THREADS; i++)	// a new run restarts the job numbers
+			{
+				track[i].job = 0;
+			}
+			continue;
+		}
+
+		if (thread >= EVT_MAX_THREADS)
+		{
+			continue;
+		}
+		jt = &track[thread];
+
+		switch (event)
+		{
+		case EVT_JOB_START:
+			jt->job++;
+			jt->start_ms = t_ms;
+			jt->release_ms = t_ms - arg / 1000.0;	// arg is the release to start delay
+			jt->missed = 0;
+			break;
+		case EVT_DEADLINE_MISS:
+			jt->missed = 1;
+			jt->misses++;
+			break;
+		case EVT_JOB_ABORT:
+			printf("%s,%u,%.3f,%.3f,%.3f,,1\n", jt->t_name, jt->job, jt->release_ms, jt->start_ms, t_ms);
+			jt->aborted++;
+			break;
+		case EVT_JOB_END:
+			printf("%s,%u,%.3f,%.3f,%.3f,%u,%d\n", jt->t_name, jt->job, jt->release_ms, jt->start_ms,
+			       t_ms, arg, jt->missed);
+			jt->jobs++;
+			jt->sum_rt_us += arg;
+			if (arg > jt->wcrt_us)
+			{
+				jt->wcrt_us = arg;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (f != stdin)
+	{
+		fclose(f);
+	}
+
+	fprintf(stderr, "%lu records\n", records);
+	if (raw)
+	{
+		return 0;
+	}
+
+	fprintf(stderr, "%-8s %8s %8s %8s %12s %12s\n", "task", "jobs", "missed", "aborted", "avg RT(us)", "WCRT(us)");
+	for (int i = 0; i < EVT_MAX_THREADS; i++)
+	{
+		if (track[i].jobs || track[i].misses)
+		{
+			fprintf(stderr, "%-8s %8u %8u %8u %12.1f %12u\n", track[i].t_name, track[i].jobs, track[i].misses,
+				track[i].aborted, track[i].jobs ? (double)track[i].sum_rt_us / track[i].jobs : 0.0, track[i].wcrt_us);
+		}
+	}
+
+	if (req_done)
+	{
+		fprintf(stderr, "requests: %lu served, average response %.3f ms, worst %.3f ms\n", req_done,
+			req_sum_ms / req_done, req_max_ms);
+	}
+
+	return 0;
+}
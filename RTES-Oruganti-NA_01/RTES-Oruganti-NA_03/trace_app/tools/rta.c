@@ -0,0 +1,235 @@
+/*
+ * Response time analysis with blocking terms for trace_app task sets.
+ *
+ * R = C + B + sum over interfering tasks of ceil(R / T) * C, iterated from
+ * R = C + B until it settles or passes the deadline (the period).
+ */
+
+#include <limits.h>
+#include <math.h>
+#include "rta.h"
+
+#define RTA_EPS 1e-9		// tolerance for the ceiling and the fixed point test
+
+static int mutex_ceiling(const struct task_s *set, int n, int mutex)	// highest priority (smallest number) using the mutex
+{
+	int ceiling = INT_MAX;
+
+	for (int j = 0; j < n; j++)
+	{
+		if (set[j].mutex_m == mutex && set[j].priority < ceiling)
+		{
+			ceiling = set[j].priority;
+		}
+	}
+
+	return ceiling;
+}
+
+double rta_part_ms(const struct task_s *t, int part, double iter_per_ms)
+{
+	if (t->workload & WORKLOAD_US)
+	{
+		return t->loop_iter[part] / 1000.0;
+	}
+
+	return t->loop_iter[part] / iter_per_ms;
+}
+
+double rta_exec_ms(const struct task_s *t, double iter_per_ms)
+{
+	return rta_part_ms(t, 0, iter_per_ms) + rta_part_ms(t, 1, iter_per_ms) + rta_part_ms(t, 2, iter_per_ms);
+}
+
+double rta_utilisation(const struct task_s *set, int n, double iter_per_ms)
+{
+	double u = 0.0;
+
+	for (int i = 0; i < n; i++)
+	{
+		u += rta_exec_ms(&set[i], iter_per_ms) / set[i].period;
+	}
+
+	return u;
+}
+
+/*
+ * A lower priority task j can block task i when its mutex may be locked by a
+ * task of i's priority or higher, i.e. the mutex ceiling is at least i's
+ * priority (direct, push-through or, under SRP, start blocking). Without a
+ * protocol nothing is pushed through, so only a task holding i's own mutex
+ * blocks it.
+ */
+static bool can_block(const struct task_s *set, int n, int i, int j, const enum lock_protocol *proto)
+{
+	if (set[j].priority <= set[i].priority)
+	{
+		return false;
+	}
+
+	if (proto[set[j].mutex_m] == LOCK_NONE)
+	{
+		return set[j].mutex_m == set[i].mutex_m;
+	}
+
+	return mutex_ceiling(set, n, set[j].mutex_m) <= set[i].priority;
+}
+
+/*
+ * Ceiling protocols (PCP, SRP) block at most once over all their mutexes, PIP
+ * once per mutex or lower priority task, whichever is less, and a mutex
+ * without a protocol once. With mixed protocols the three terms add up.
+ */
+static double blocking_term(const struct task_s *set, int n, int i, double iter_per_ms,
+			    const enum lock_protocol *proto)
+{
+	double longest_ceiling = 0.0;	// longest blocking section under PCP or SRP
+	double longest_none = 0.0;	// longest blocking section without a protocol
+	double per_task = 0.0;		// PIP bound: once per lower priority task
+	double per_mutex = 0.0;		// PIP bound: once per mutex
+
+	for (int j = 0; j < n; j++)
+	{
+		double cs = rta_part_ms(&set[j], 1, iter_per_ms);
+
+		if (!can_block(set, n, i, j, proto))
+		{
+			continue;
+		}
+
+		switch (proto[set[j].mutex_m])
+		{
+		case LOCK_PIP:
+			per_task += cs;
+			break;
+		case LOCK_NONE:
+			longest_none = cs > longest_none ? cs : longest_none;
+			break;
+		default:
+			longest_ceiling = cs > longest_ceiling ? cs : longest_ceiling;
+			break;
+		}
+	}
+
+	for (int m = 0; m < MAX_MUTEXES; m++)
+	{
+		double longest_m = 0.0;
+
+		if (proto[m] != LOCK_PIP)
+		{
+			continue;
+		}
+
+		for (int j = 0; j < n; j++)
+		{
+			if (set[j].mutex_m == m && can_block(set, n, i, j, proto) &&
+			    rta_part_ms(&set[j], 1, iter_per_ms) > longest_m)
+			{
+				longest_m = rta_part_ms(&set[j], 1, iter_per_ms);
+			}
+		}
+		per_mutex += longest_m;
+	}
+
+	return longest_ceiling + longest_none + (per_task < per_mutex ? per_task : per_mutex);
+}
+
+/*
+ * Tasks that delay task i: all tasks of equal or higher priority and, without
+ * a locking protocol, the medium priority tasks that preempt the lock owner
+ * while task i waits (unbounded priority inversion).
+ */
+static bool interferes(const struct task_s *set, int n, int i, int j, const enum lock_protocol *proto)
+{
+	int lowest_blocker = set[i].priority;
+
+	if (j == i)
+	{
+		return false;
+	}
+
+	if (set[j].priority <= set[i].priority)
+	{
+		return true;
+	}
+
+	for (int k = 0; k < n; k++)		// only owners of a mutex without a protocol can be preempted while i waits
+	{
+		if (proto[set[k].mutex_m] == LOCK_NONE && can_block(set, n, i, k, proto) &&
+		    set[k].priority > lowest_blocker)
+		{
+			lowest_blocker = set[k].priority;
+		}
+	}
+
+	return set[j].priority < lowest_blocker && !can_block(set, n, i, j, proto);
+}
+
+int rta_analyze(const struct task_s *set, int n, double iter_per_ms, const enum lock_protocol *proto,
+		struct rta_result *res)
+{
+	int unschedulable = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		struct rta_result *r = &res[i];
+		double deadline = set[i].period;
+		double prev = 0.0;
+
+		r->c_ms = rta_exec_ms(&set[i], iter_per_ms);
+		r->cs_ms = rta_part_ms(&set[i], 1, iter_per_ms);
+		r->blocking_ms = blocking_term(set, n, i, iter_per_ms, proto);
+		r->response_ms = r->c_ms + r->blocking_ms;
+
+		while (r->response_ms <= deadline + RTA_EPS && fabs(r->response_ms - prev) > RTA_EPS)
+		{
+			prev = r->response_ms;
+			r->response_ms = r->c_ms + r->blocking_ms;
+
+			for (int j = 0; j < n; j++)
+			{
+				if (interferes(set, n, i, j, proto))
+				{
+					r->response_ms += ceil(prev / set[j].period - RTA_EPS) * rta_exec_ms(&set[j], iter_per_ms);
+				}
+			}
+		}
+
+		r->schedulable = r->response_ms <= deadline + RTA_EPS;
+		if (!r->schedulable)
+		{
+			unschedulable++;
+		}
+	}
+
+	return unschedulable;
+}
+
+/*
+ * EDF with deadlines equal to the periods and the priorities used as
+ * preemption levels (rate monotonic order), Baker's test: for every task k,
+ * the utilisation of the tasks with a period up to T_k plus B_k / T_k must
+ * not exceed 1.
+ */
+bool rta_edf_schedulable(const struct task_s *set, int n, double iter_per_ms, const enum lock_protocol *proto)
+{
+	for (int k = 0; k < n; k++)
+	{
+		double load = blocking_term(set, n, k, iter_per_ms, proto) / set[k].period;
+
+		for (int i = 0; i < n; i++)
+		{
+			if (set[i].period <= set[k].period)
+			{
+				load += rta_exec_ms(&set[i], iter_per_ms) / set[i].period;
+			}
+		}
+
+		if (load > 1.0 + RTA_EPS)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
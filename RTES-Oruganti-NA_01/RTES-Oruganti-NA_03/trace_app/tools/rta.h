@@ -0,0 +1,34 @@
+#ifndef __RTA_H__
+#define __RTA_H__
+
+/*
+ * Host side response time analysis for trace_app task sets.
+ *
+ * Fixed priority preemptive scheduling, deadline equal to the period,
+ * one critical section (loop_iter[1]) per task guarded by mutex_m, each
+ * mutex with its own locking protocol (enum lock_protocol of task_model.h).
+ * Zephyr priorities: a smaller number is a higher priority.
+ */
+
+#include <stdbool.h>
+
+#define TASK_MODEL_TYPES_ONLY		// only struct task_s, the firmware owns the task set variables
+#include "../src/task_model.h"
+
+struct rta_result
+{
+	double c_ms;		// execution time of the job in milliseconds
+	double cs_ms;		// length of the critical section in milliseconds
+	double blocking_ms;	// blocking term by lower priority tasks in milliseconds
+	double response_ms;	// worst case response time in milliseconds, first value past the deadline when unschedulable
+	bool schedulable;	// response time within the period
+};
+
+double rta_part_ms(const struct task_s *t, int part, double iter_per_ms);
+double rta_exec_ms(const struct task_s *t, double iter_per_ms);
+double rta_utilisation(const struct task_s *set, int n, double iter_per_ms);
+int rta_analyze(const struct task_s *set, int n, double iter_per_ms, const enum lock_protocol *proto,
+		struct rta_result *res);
+bool rta_edf_schedulable(const struct task_s *set, int n, double iter_per_ms, const enum lock_protocol *proto);
+
+#endif // __RTA_H__
@@ -0,0 +1,135 @@
+#!/bin/sh
+#
+# Checks the response time analysis of tools/rta against native_posix runs.
+#
+# Runs the task_model.h set and a number of UUniFast sets headless through
+# bench.sh (RM, every locking protocol), analyses the same sets with rta at
+# the speed the workload kernels are emulated with on native_posix (50000
+# iterations per ms, see common/workload.c), and fails when a run
+#
+#   - has a task whose measured WCRT is above its predicted response time, or
+#   - misses a deadline of a task that rta predicts to be schedulable.
+#
+# Tasks predicted to miss may miss or not; their WCRT is not compared.
+#
+# usage: tools/rta_check.sh [-k uunifast_sets] [-s first_seed] [-u utilisation] [-e tolerance_us] [-t timeout_s]
+#
+# Exits with 1 when a check failed. Needs west and a Zephyr tree
+# (ZEPHYR_BASE), as bench.sh.
+
+SETS=5
+SEED=1
+UTIL=0.7
+TOL_US=0
+TIMEOUT=120
+ITER_PER_MS=50000		# WL_POSIX_ITER_PER_MS of common/workload.c
+APP_DIR=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$APP_DIR/build/rta_check
+
+while getopts "k:s:u:e:t:h" opt; do
+	case $opt in
+	k) SETS=$OPTARG ;;
+	s) SEED=$OPTARG ;;
+	u) UTIL=$OPTARG ;;
+	e) TOL_US=$OPTARG ;;
+	t) TIMEOUT=$OPTARG ;;
+	*) sed -n '3,18p' "$0"; exit 1 ;;
+	esac
+done
+
+mkdir -p "$WORK"
+gcc -O2 -o "$WORK/rta" "$APP_DIR/tools/rta_main.c" "$APP_DIR/tools/rta.c" -lm || exit 1
+gcc -O2 -o "$WORK/uunifast" "$APP_DIR/tools/uunifast.c" -lm || exit 1
+
+checked=0
+failed=0
+
+# to_header <taskset file> <header>: THREAD0..THREAD3 and TOTAL_TIME of the first set in the file
+to_header() {
+	awk '
+		$1 == "taskset" && $2 == "add" && n < 4 {
+			printf "#define THREAD%d {\"%s\", %s, %s, {%s, %s, %s}, %s}\n", n++, $3, $4, $5, $6, $7, $8, $9
+		}
+		$1 == "taskset" && $2 == "time" { printf "#define TOTAL_TIME %s\n", $3 }
+		$1 == "activate" { exit }
+		END { exit n != 4 }' "$1" > "$2"
+}
+
+# predict <protocol> [taskset file]: "task,R_us,miss" for every task of the set
+predict() {
+	"$WORK/rta" -i $ITER_PER_MS -p "$1" ${2:+-f "$2"} |
+		awk 'NF >= 7 && $2 ~ /^[0-9]+$/ { printf "%s,%.0f,%d\n", $1, $7 * 1000, $8 == "MISS" }'
+}
+
+# compare <set> <MUTEX_PROTOCOL value> <prediction file> <bench.sh csv>
+compare() {
+	awk -F, -v set="$1" -v proto="$2" -v tol="$TOL_US" '
+		FNR == NR { r[$1] = $2; miss[$1] = $3; next }
+		$3 != proto || !($4 in r) { next }
+		$5 == "wcrt_us" {
+			seen[$4] = 1
+			if (!miss[$4] && $6 > r[$4] + tol) {
+				printf "%s %s %s: WCRT %d us above the predicted %d us\n", set, proto, $4, $6, r[$4]
+				bad++
+			}
+		}
+		$5 == "missed" && $6 > 0 && !miss[$4] {
+			printf "%s %s %s: %d deadline misses, predicted schedulable\n", set, proto, $4, $6
+			bad++
+		}
+		END {
+			for (t in r) {
+				if (!(t in seen)) {
+					printf "%s %s %s: no RESULT line\n", set, proto, t
+					bad++
+				}
+			}
+			exit bad > 0
+		}' "$3" "$4"
+}
+
+# check_set <name> [taskset file]: run the set under every protocol and compare with rta
+check_set() {
+	csv="$WORK/$1.csv"
+	header=""
+
+	if [ -n "$2" ]; then
+		header="$WORK/$1.h"
+		if ! to_header "$2" "$header"; then
+			echo "$1: not a set of four tasks"
+			failed=$((failed + 1))
+			return
+		fi
+	fi
+
+	if ! "$APP_DIR/bench.sh" -t "$TIMEOUT" -o "$csv" ${header:+-s "$header"} \
+		SCHED_MODE=SCHED_RM MUTEX_PROTOCOL=LOCK_NONE,LOCK_PIP,LOCK_PCP,LOCK_SRP; then
+		echo "$1: benchmark failed"
+		failed=$((failed + 1))
+		return
+	fi
+
+	for proto in none pip pcp srp; do
+		pred="$WORK/$1-$proto.pred"
+		predict "$proto" "$2" > "$pred"
+		checked=$((checked + 1))
+		if compare "$1" "LOCK_$(echo "$proto" | tr a-z A-Z)" "$pred" "$csv"; then
+			echo "$1 $proto: ok"
+		else
+			failed=$((failed + 1))
+		fi
+	done
+}
+
+check_set default
+
+i=0
+while [ $i -lt "$SETS" ]; do
+	seed=$((SEED + i))
+	"$WORK/uunifast" -n 4 -m 3 -k 1 -u "$UTIL" -i $ITER_PER_MS -s $seed > "$WORK/uunifast$seed.txt"
+	check_set "uunifast$seed" "$WORK/uunifast$seed.txt"
+	i=$((i + 1))
+done
+
+echo "$checked checks, $failed failed"
+[ $failed -eq 0 ]
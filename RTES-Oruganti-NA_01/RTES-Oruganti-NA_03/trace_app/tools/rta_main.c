@@ -0,0 +1,249 @@
+/*
+ * Offline schedulability check for trace_app task sets.
+ *
+ * Without -f the set of task_model.h (THREAD0..THREAD3) is analysed.
+ * With -f the file is read as the "taskset" shell commands accepted by
+ * the board (for example the output of uunifast); every "activate" or the
+ * end of the file analyses the set built so far. "taskset mutex" lines set
+ * the protocol of a mutex as on the board; -p sets it for all mutexes,
+ * otherwise MUTEX_PROTOCOLS of task_model.h applies.
+ *
+ * -i takes the iterations per millisecond that the "calibrate" shell command
+ * prints for the kernel the iteration counts are given for (tasks given in
+ * microseconds do not need it). -s takes a saved "stats" dump of a run of
+ * the same set and puts the measured WCRT next to the prediction.
+ *
+ * Build: gcc -O2 -o rta tools/rta_main.c tools/rta.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rta.h"
+
+static const struct task_s default_threads[NUM_THREADS] = {THREAD0, THREAD1, THREAD2, THREAD3};
+
+static const char * const proto_names[LOCK_PROTOCOLS] = LOCK_PROTOCOL_NAMES;
+static enum lock_protocol mutex_proto[MAX_MUTEXES] = MUTEX_PROTOCOLS;
+
+static int parse_proto(const char *name)
+{
+	for (int p = 0; p < LOCK_PROTOCOLS; p++)
+	{
+		if (strcmp(name, proto_names[p]) == 0)
+		{
+			return p;
+		}
+	}
+
+	return -1;
+}
+
+struct observed
+{
+	char t_name[32];	// task name in the stats dump
+	double wcrt_ms;		// measured worst case response time
+	int misses;		// measured deadline misses
+};
+
+static struct observed observed[MAX_THREADS];
+static int num_observed;
+
+static void load_stats(const char *path)	// picks the per-task rows of a saved "stats" dump
+{
+	char line[256];
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+	{
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f) && num_observed < MAX_THREADS)
+	{
+		struct observed o;
+		unsigned rel, lost, done, met, last, wcrt, late;
+
+		// task released lost done met missed last(us) wcrt(us) late(us)
+		if (sscanf(line, "%31s %u %u %u %u %d %u %u %u", o.t_name, &rel, &lost, &done, &met,
+			   &o.misses, &last, &wcrt, &late) == 9)
+		{
+			o.wcrt_ms = wcrt / 1000.0;
+			observed[num_observed++] = o;
+		}
+	}
+
+	fclose(f);
+}
+
+static const struct observed *find_observed(const char *name)
+{
+	for (int i = 0; i < num_observed; i++)
+	{
+		if (strcmp(observed[i].t_name, name) == 0)
+		{
+			return &observed[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int report(int set_no, const struct task_s *set, int n, double iter_per_ms)
+{
+	struct rta_result res[MAX_THREADS];
+	int misses = rta_analyze(set, n, iter_per_ms, mutex_proto, res);
+	double u = rta_utilisation(set, n, iter_per_ms);
+	int mutexes = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (set[i].mutex_m >= mutexes)
+		{
+			mutexes = set[i].mutex_m + 1;
+		}
+	}
+
+	printf("set %d: %d tasks, U = %.3f, protocols", set_no, n, u);
+	for (int m = 0; m < mutexes; m++)
+	{
+		printf(" %d:%s", m, proto_names[mutex_proto[m]]);
+	}
+	printf(": %s under RM, %s under EDF\n", misses ? "NOT schedulable" : "schedulable",
+	       rta_edf_schedulable(set, n, iter_per_ms, mutex_proto) ? "schedulable" : "NOT schedulable");
+	printf("%-8s %5s %7s %9s %9s %9s %9s %s\n", "task", "prio", "T(ms)", "C(ms)", "CS(ms)",
+	       "B(ms)", "R(ms)", num_observed ? "measured WCRT(ms)" : "");
+
+	for (int i = 0; i < n; i++)
+	{
+		const struct observed *o = find_observed(set[i].t_name);
+
+		printf("%-8s %5d %7d %9.2f %9.2f %9.2f %9.2f %s", set[i].t_name, set[i].priority,
+		       set[i].period, res[i].c_ms, res[i].cs_ms, res[i].blocking_ms, res[i].response_ms,
+		       res[i].schedulable ? "" : "MISS");
+		if (o)
+		{
+			printf(" %9.2f%s", o->wcrt_ms, o->wcrt_ms > res[i].response_ms ? " above prediction" : "");
+		}
+		printf("\n");
+	}
+	printf("\n");
+
+	return misses ? 0 : 1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-i iter_per_ms] [-p none|pip|pcp|srp] [-f taskset_file] [-s stats_file]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct task_s set[MAX_THREADS];
+	double iter_per_ms = 50000.0;
+	const char *file = NULL;
+	int n = 0, sets = 0, ok = 0;
+	char line[256];
+	FILE *f;
+	int opt, id;
+
+	while ((opt = getopt(argc, argv, "i:p:f:s:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i': iter_per_ms = atof(optarg); break;
+		case 'p':
+			id = parse_proto(optarg);
+			if (id < 0)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			for (int m = 0; m < MAX_MUTEXES; m++)
+			{
+				mutex_proto[m] = id;
+			}
+			break;
+		case 'f': file = optarg; break;
+		case 's': load_stats(optarg); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+
+	if (iter_per_ms <= 0.0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!file)
+	{
+		memcpy(set, default_threads, sizeof(default_threads));
+		return report(0, set, NUM_THREADS, iter_per_ms) ? 0 : 2;
+	}
+
+	f = strcmp(file, "-") ? fopen(file, "r") : stdin;
+	if (!f)
+	{
+		perror(file);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		struct task_s t;
+		char unit[8] = "iter";
+		char name[8];
+
+		memset(&t, 0, sizeof(t));
+
+		if (strncmp(line, "taskset clear", 13) == 0)
+		{
+			n = 0;
+		}
+		else if (sscanf(line, "taskset mutex %d %7s", &id, name) == 2)
+		{
+			if (id < 0 || id >= MAX_MUTEXES || parse_proto(name) < 0)
+			{
+				fprintf(stderr, "rejected: %s", line);
+				continue;
+			}
+			mutex_proto[id] = parse_proto(name);
+		}
+		else if (sscanf(line, "taskset add %31s %d %d %d %d %d %d %*s %7s", t.t_name, &t.priority, &t.period,
+				&t.loop_iter[0], &t.loop_iter[1], &t.loop_iter[2], &t.mutex_m, unit) >= 7)
+		{
+			if (strcmp(unit, "us") == 0)
+			{
+				t.workload |= WORKLOAD_US;
+			}
+
+			if (n == MAX_THREADS || t.period <= 0 || t.mutex_m < 0 || t.mutex_m >= MAX_MUTEXES)
+			{
+				fprintf(stderr, "rejected: %s", line);
+				continue;
+			}
+			set[n++] = t;
+		}
+		else if (strncmp(line, "activate", 8) == 0 && n > 0)
+		{
+			ok += report(sets++, set, n, iter_per_ms);
+		}
+	}
+
+	if (f != stdin)
+	{
+		fclose(f);
+	}
+
+	if (sets == 0 && n > 0)		// file without activate
+	{
+		ok += report(sets++, set, n, iter_per_ms);
+	}
+
+	printf("%d of %d task sets schedulable\n", ok, sets);
+
+	return ok == sets ? 0 : 2;
+}
@@ -0,0 +1,135 @@
+/*
+ * Host side task set generator for trace_app.
+ *
+ * Draws task utilisations with UUniFast (Bini and Buttazzo) for a target
+ * total utilisation, log-uniform periods, rate monotonic priorities and
+ * prints every task set as "taskset" shell commands, so the sets can be
+ * pasted (or piped) into the board console one after the other.
+ *
+ * With -U the execution times are printed in microseconds for the calibrated
+ * workload kernels of the board, otherwise as iterations at -i per ms.
+ *
+ * Build: gcc -O2 -o uunifast tools/uunifast.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define MAX_THREADS 10		// must match MAX_THREADS in src/task_model.h
+#define MAX_MUTEXES 8		// must match MAX_MUTEXES in src/task_model.h
+#define BASE_PRIO 2		// priority of the task with the shortest period
+
+struct gen_task
+{
+	double util;		// utilisation of the task
+	int period;		// period in milliseconds
+	int mutex_m;		// mutex used by the critical section
+};
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static double rand_unit(void)		// xorshift64*, uniform in (0, 1)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+
+	return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0) + 1e-17;
+}
+
+static void uunifast(struct gen_task *t, int n, double total_util)
+{
+	double sum = total_util;
+
+	for (int i = 1; i < n; i++)
+	{
+		double next = sum * pow(rand_unit(), 1.0 / (n - i));
+
+		t[i - 1].util = sum - next;
+		sum = next;
+	}
+	t[n - 1].util = sum;
+}
+
+static int by_period(const void *a, const void *b)
+{
+	return ((const struct gen_task *)a)->period - ((const struct gen_task *)b)->period;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n tasks] [-u utilisation] [-k sets] [-m mutexes] [-c cs_fraction]\n"
+		"          [-p min_period_ms] [-P max_period_ms] [-i iter_per_ms] [-t total_ms] [-s seed]\n"
+		"          [-U] [-w alu|mem|cache]\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct gen_task t[MAX_THREADS];
+	int n = 4, sets = 1, mutexes = 3, pmin = 10, pmax = 1000, total_ms = 4000;
+	double util = 0.7, cs = 0.2, iter_per_ms = 50000.0;
+	const char *workload = "alu";
+	int in_us = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:u:k:m:c:p:P:i:t:s:Uw:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': n = atoi(optarg); break;
+		case 'u': util = atof(optarg); break;
+		case 'k': sets = atoi(optarg); break;
+		case 'm': mutexes = atoi(optarg); break;
+		case 'c': cs = atof(optarg); break;
+		case 'p': pmin = atoi(optarg); break;
+		case 'P': pmax = atoi(optarg); break;
+		case 'i': iter_per_ms = atof(optarg); break;
+		case 't': total_ms = atoi(optarg); break;
+		case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+		case 'U': in_us = 1; break;
+		case 'w': workload = optarg; break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+
+	if (n < 1 || n > MAX_THREADS || mutexes < 1 || mutexes > MAX_MUTEXES || util <= 0.0 ||
+	    cs < 0.0 || cs > 1.0 || pmin < 1 || pmax < pmin || iter_per_ms <= 0.0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (int k = 0; k < sets; k++)
+	{
+		uunifast(t, n, util);
+
+		for (int i = 0; i < n; i++)		// log-uniform periods spread the set over several decades
+		{
+			t[i].period = (int)exp(log(pmin) + rand_unit() * (log(pmax + 1) - log(pmin)));
+			t[i].mutex_m = (int)(rand_unit() * mutexes) % mutexes;
+		}
+
+		qsort(t, n, sizeof(t[0]), by_period);	// rate monotonic: shorter period, higher priority
+
+		printf("taskset clear\n");
+		for (int i = 0; i < n; i++)
+		{
+			double amount = t[i].util * t[i].period * (in_us ? 1000.0 : iter_per_ms);
+			long crit = (long)(amount * cs);
+			long outer = (long)((amount - crit) / 2);
+
+			printf("taskset add task%d%d %d %d %ld %ld %ld %d %s %s\n", i, i, BASE_PRIO + i, t[i].period,
+			       outer, crit, outer, t[i].mutex_m, workload, in_us ? "us" : "iter");
+		}
+		printf("taskset time %d\n", total_ms);
+		printf("activate\n");
+	}
+
+	return 0;
+}
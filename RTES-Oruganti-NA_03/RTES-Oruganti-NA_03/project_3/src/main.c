@@ -10,6 +10,7 @@
 #include <zephyr.h>
 #include <device.h>
 #include <drivers/sensor.h>
+#include <drivers/sensor/hc_sr04.h>
 #include <stdio.h>
 #include <sys/__assert.h>
 #include <sys/byteorder.h>
@@ -28,7 +29,9 @@
 #include <net/coap.h>
 #include <net/coap_link_format.h>
 #include <drivers/gpio.h>
+#include <shell/shell.h>
 #include <stdlib.h>
+#include <math.h>
 
 #define DEBUG 
 
@@ -63,12 +66,13 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 #define PIN2	DT_GPIO_PIN(LED_BLUE, gpios)
 #define FLAGS2	DT_GPIO_FLAGS(LED_BLUE, gpios)
 
+#define NUM_SENSORS 2
+
 //Device structures as global parameters
-const struct device *dev1, *dev2;
+const struct device *ssr_dev[NUM_SENSORS];
 const struct device *gpio_1, *gpio_3;
 int flag =0;
-int sensor0_flag=0;
-int sensor1_flag=0;
+int sensor_flag[NUM_SENSORS];	//sensor being observed
 
 //CoAP server definitions
 #include "net_private.h"
@@ -83,11 +87,19 @@ int sensor1_flag=0;
 
 #define NUM_PENDINGS 3
 
+//Response buffers: one held by each pending CON message, one for the reply
+//being built by the CoAP loop and one for a notification from the sensor thread
+#define NUM_COAP_BUFS (NUM_PENDINGS + 2)
+
+#define SENSOR_MAX_AGE_MS 2000	//default age past which a cached reading is not served
+
 int sampling_period = 500;
+int sensor_max_age = SENSOR_MAX_AGE_MS;
 
 static const char * const ssr_path0[] = { "sensor", "hcsr_0", NULL };
 static const char * const ssr_path1[] = { "sensor", "hcsr_1", NULL };
 static const char * const ssr_period[] = { "sensor", "period", NULL };
+static const char * const ssr_max_age[] = { "sensor", "max_age", NULL };
 
 static const char * const led_r_path[] = { "led", "led_r", NULL };
 static const char * const led_g_path[] = { "led", "led_g", NULL };
@@ -100,28 +112,63 @@ static struct coap_observer observers[NUM_OBSERVERS];
 
 static struct coap_pending pendings[NUM_PENDINGS];
 
-static struct coap_resource *resource_to_notify1;
-static struct coap_resource *resource_to_notify2;
+static struct coap_resource *resource_to_notify_s[NUM_SENSORS];
 static struct coap_resource *resource_to_notify;
 
 static struct k_work_delayable retransmit_work;
 
-//Sensor flags for observe 
-struct sensor_value distance;
+K_MEM_SLAB_DEFINE(coap_buf_slab, MAX_COAP_MSG_LEN, NUM_COAP_BUFS, 4);
 
-float prev_dist1 = 0.0f;
-float prev_dist2 = 0.0f;
-float curr_dist1 = 0.0f;
-float curr_dist2 = 0.0f;
+static atomic_t coap_buf_peak;		//most buffers in use at once
+static atomic_t coap_buf_failed;	//allocations the pool could not serve
+
+//Sensor values for observe 
+float prev_dist[NUM_SENSORS];
+float curr_dist[NUM_SENSORS];
 int obs_start; 
-//HC-SR04 Ultrasonic Senor measurement function using the driver
-static int distance_measure(const struct device *dev)
+
+//Last good reading of each sensor, written by the sampling thread and served by sensor_get()
+struct dist_cache {
+	float dist;		//inches
+	int64_t stamp;		//uptime in ms when it was taken
+	bool valid;
+};
+
+static struct dist_cache dist_cache[NUM_SENSORS];
+static struct k_spinlock dist_cache_lock;
+
+static void dist_cache_put(int sensor, float dist)
+{
+	k_spinlock_key_t key = k_spin_lock(&dist_cache_lock);
+
+	dist_cache[sensor].dist = dist;
+	dist_cache[sensor].stamp = k_uptime_get();
+	dist_cache[sensor].valid = true;
+	k_spin_unlock(&dist_cache_lock, key);
+}
+
+//Cached reading of a sensor and its age in ms, -EAGAIN before the first one
+static int dist_cache_get(int sensor, float *dist, int64_t *age)
+{
+	k_spinlock_key_t key = k_spin_lock(&dist_cache_lock);
+	struct dist_cache c = dist_cache[sensor];
+
+	k_spin_unlock(&dist_cache_lock, key);
+	if (!c.valid) {
+		return -EAGAIN;
+	}
+	*dist = c.dist;
+	*age = k_uptime_get() - c.stamp;
+	return 0;
+}
+
+//HC-SR04 Ultrasonic Senor reading of a measurement that ended with status
+static int distance_read(const struct device *dev, int status, struct sensor_value *distance)
 {
     int ret;
-    ret = sensor_sample_fetch_chan(dev, SENSOR_CHAN_ALL);
-    switch (ret) {
+    switch (status) {
     case 0:
-        ret = sensor_channel_get(dev, SENSOR_CHAN_DISTANCE, &distance);
+        ret = sensor_channel_get(dev, SENSOR_CHAN_DISTANCE, distance);
         if (ret) {
             LOG_ERR("sensor_channel_get failed ret %d", ret);
             return ret;
@@ -218,6 +265,36 @@ static int send_coap_reply(struct coap_packet *cpkt,
 	return r;
 }
 
+//Takes a response buffer from the pool, never waits
+static uint8_t *coap_buf_alloc(void)
+{
+	void *buf;
+	atomic_val_t used, peak;
+
+	if (k_mem_slab_alloc(&coap_buf_slab, &buf, K_NO_WAIT) != 0) {
+		atomic_inc(&coap_buf_failed);
+		LOG_WRN("No CoAP response buffer free");
+		return NULL;
+	}
+
+	used = k_mem_slab_num_used_get(&coap_buf_slab);
+	do {
+		peak = atomic_get(&coap_buf_peak);
+	} while (used > peak && !atomic_cas(&coap_buf_peak, peak, used));
+
+	return buf;
+}
+
+//Returns a response buffer to the pool, NULL is ignored
+static void coap_buf_free(uint8_t *buf)
+{
+	void *mem = buf;
+
+	if (mem) {
+		k_mem_slab_free(&coap_buf_slab, &mem);
+	}
+}
+
 //well known core - get function()
 static int well_known_core_get(struct coap_resource *resource,
 			       struct coap_packet *request,
@@ -227,7 +304,7 @@ static int well_known_core_get(struct coap_resource *resource,
 	uint8_t *data;
 	int r;
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = coap_buf_alloc();
 	if (!data) {
 		return -ENOMEM;
 	}
@@ -241,10 +318,7 @@ static int well_known_core_get(struct coap_resource *resource,
 	r = send_coap_reply(&response, addr, addr_len);
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 
 	return r;
 }
@@ -279,7 +353,7 @@ static int led_get(struct coap_resource *resource,
 		type = COAP_TYPE_NON_CON;
 	}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = coap_buf_alloc();
 	if (!data) {
 		return -ENOMEM;
 	}
@@ -339,10 +413,7 @@ static int led_get(struct coap_resource *resource,
 	r = send_coap_reply(&response, addr, addr_len);
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 
 	return r;
 }
@@ -406,7 +477,7 @@ static int led_put(struct coap_resource *resource,
 		type = COAP_TYPE_NON_CON;
 	}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = coap_buf_alloc();
 	if (!data) {
 		return -ENOMEM;
 	}
@@ -421,16 +492,14 @@ static int led_put(struct coap_resource *resource,
 	r = send_coap_reply(&response, addr, addr_len);
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 
 	return r;
 }
 
-//Sensor period put function for setting the sampling period
-static int sensor_period_put(struct coap_resource *resource,
+//Sensor setting put function for the sampling period and the max age of the
+//cached readings, resource->user_data points at the setting
+static int sensor_setting_put(struct coap_resource *resource,
 		    struct coap_packet *request,
 		    struct sockaddr *addr, socklen_t addr_len)
 {
@@ -445,8 +514,8 @@ static int sensor_period_put(struct coap_resource *resource,
 	uint16_t id;
 	int r;
 
-	int period = 0;
-	int temp[10];
+	int value = 0;
+	uint8_t reply = COAP_RESPONSE_CODE_CHANGED;
 
 	code = coap_header_get_code(request);
 	type = coap_header_get_type(request);
@@ -462,15 +531,16 @@ static int sensor_period_put(struct coap_resource *resource,
 		net_hexdump("PUT Payload", payload, payload_len);
 
 		//Converting the payload string to integer value
-		for (int i = 0; i < payload_len; i++)
+		for (int i = 0; i < payload_len && payload[i] >= '0' && payload[i] <= '9'; i++)
 		{
-			temp[i] = (int) *payload;
-			temp[i] = temp[i] - 48;
-			period = (period + temp[i])*10;
-			payload++;
+			value = value * 10 + (payload[i] - '0');
+		}
+		//A period of 0 would spin the sampling thread, a max age of 0 would never serve a reading
+		if (value > 0) {
+			*(int *)resource->user_data = value;
+		} else {
+			reply = COAP_RESPONSE_CODE_BAD_REQUEST;
 		}
-		period = period / 10;
-		sampling_period = period;  //Sampling period
 	}
 
 	if (type == COAP_TYPE_CON) {
@@ -479,14 +549,14 @@ static int sensor_period_put(struct coap_resource *resource,
 		type = COAP_TYPE_NON_CON;
 	}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = coap_buf_alloc();
 	if (!data) {
 		return -ENOMEM;
 	}
 
 	r = coap_packet_init(&response, data, MAX_COAP_MSG_LEN,
 			     COAP_VERSION_1, type, tkl, token,
-			     COAP_RESPONSE_CODE_CHANGED, id);
+			     reply, id);
 	if (r < 0) {
 		goto end;
 	}
@@ -494,10 +564,7 @@ static int sensor_period_put(struct coap_resource *resource,
 	r = send_coap_reply(&response, addr, addr_len);
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 
 	return r;
 }
@@ -519,7 +586,7 @@ static void retransmit_request(struct k_work *work)
 	}
 
 	if (!coap_pending_cycle(pending)) {
-		k_free(pending->data);
+		coap_buf_free(pending->data);
 		coap_pending_clear(pending);
 		return;
 	}
@@ -578,7 +645,7 @@ static int send_notification_packet(const struct sockaddr *addr,
 		id = coap_next_id();
 	}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = coap_buf_alloc();
 	if (!data) {
 		return -ENOMEM;
 	}
@@ -613,13 +680,13 @@ static int send_notification_packet(const struct sockaddr *addr,
 	{
 		r = snprintk((char *) payload, sizeof(payload), "Observation Started");
 	}
-	if(flag == 1 && sensor0_flag ==1)
+	if(flag == 1 && sensor_flag[0] ==1)
 	{
-		r = snprintk((char *) payload, sizeof(payload), "Distance(s0), Old: %f:, New: %f", prev_dist1, curr_dist1);
+		r = snprintk((char *) payload, sizeof(payload), "Distance(s0), Old: %f:, New: %f", prev_dist[0], curr_dist[0]);
 	}
-	else if(flag == 1 && sensor1_flag ==1)
+	else if(flag == 1 && sensor_flag[1] ==1)
 	{
-		r = snprintk((char *) payload, sizeof(payload), "Distance(s1), Old: %f:, New: %f", prev_dist2, curr_dist2);
+		r = snprintk((char *) payload, sizeof(payload), "Distance(s1), Old: %f:, New: %f", prev_dist[1], curr_dist[1]);
 	}
 	
 	if (r < 0) {
@@ -641,16 +708,14 @@ static int send_notification_packet(const struct sockaddr *addr,
 
 	r = send_coap_reply(&response, addr, addr_len);
 
-	/* On succesfull creation of pending request, do not free memory */
+	/* On succesfull creation of pending request, the buffer belongs to it
+	 * and goes back to the pool when the pending request is cleared */
 	if (type == COAP_TYPE_CON) {
 		return r;
 	}
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 
 	return r;
 }
@@ -662,9 +727,9 @@ static int sensor_get(struct coap_resource *resource,
 {
     struct coap_packet response;
 	struct coap_observer *observer;
-	uint8_t payload[40];
+	uint8_t payload[48];
 	uint8_t token[COAP_TOKEN_MAX_LEN];
-	uint8_t *data;
+	uint8_t *data = NULL;
 	uint16_t id;
 	uint8_t code;
 	uint8_t type;
@@ -673,8 +738,8 @@ static int sensor_get(struct coap_resource *resource,
 	bool observe = true;
 	obs_start = 0;
 	flag = 0;
-	sensor0_flag = 0;
-	sensor1_flag = 0;
+	sensor_flag[0] = 0;
+	sensor_flag[1] = 0;
 
 	code = coap_header_get_code(request);
 	type = coap_header_get_type(request);
@@ -691,11 +756,6 @@ static int sensor_get(struct coap_resource *resource,
 		type = COAP_TYPE_NON_CON;
 	}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-	if (!data) {
-		return -ENOMEM;
-	}
-
 	if (coap_request_is_observe(request)) 
 	{
 		observer = coap_observer_next_unused(observers, NUM_OBSERVERS);
@@ -719,15 +779,15 @@ static int sensor_get(struct coap_resource *resource,
 			
 			if (strcmp((const char *)ssr_path0, (const char *)resource->path) == 0)
 			{
-				sensor0_flag = 1;
-				sensor1_flag = 0;
-				resource_to_notify1 = resource;
+				sensor_flag[0] = 1;
+				sensor_flag[1] = 0;
+				resource_to_notify_s[0] = resource;
 			}
 			else if (strcmp((const char *)ssr_path1, (const char *)resource->path) == 0)
 			{
-				sensor0_flag = 0;
-				sensor1_flag = 1;
-				resource_to_notify2 = resource;
+				sensor_flag[0] = 0;
+				sensor_flag[1] = 1;
+				resource_to_notify_s[1] = resource;
 			}
 			obs_start = 1;
 			send_notification_packet(addr, addr_len,
@@ -738,8 +798,8 @@ static int sensor_get(struct coap_resource *resource,
 		else if (coap_get_option_int(request, COAP_OPTION_OBSERVE) == 1)
 		{
 			flag = 0;
-			sensor0_flag = 0;
-			sensor1_flag = 0;
+			sensor_flag[0] = 0;
+			sensor_flag[1] = 0;
 			send_notification_packet(addr, addr_len,
                 resource->age,
                 id, token, tkl, false);
@@ -747,9 +807,36 @@ static int sensor_get(struct coap_resource *resource,
 	}
 	else
 	{
+		//The observe replies take their own buffers in send_notification_packet()
+		data = coap_buf_alloc();
+		if (!data) {
+			return -ENOMEM;
+		}
+
+		//Served from the cache, the sampling thread does the measuring
+		char temp[10];
+		int sensor = -1;
+		float dist;
+		int64_t age;
+		bool fresh;
+
+		if (strcmp((const char *)ssr_path0, (const char *)resource->path) == 0)
+		{
+			strcpy(temp, "Sensor 0");
+			sensor = 0;
+		}
+		else if (strcmp((const char *)ssr_path1, (const char *)resource->path) == 0)
+		{
+			strcpy(temp, "Sensor 1");
+			sensor = 1;
+		}
+		fresh = sensor >= 0 && dist_cache_get(sensor, &dist, &age) == 0 &&
+			age <= sensor_max_age;
+
 		r = coap_packet_init(&response, data, MAX_COAP_MSG_LEN,
 			     COAP_VERSION_1, type, tkl, token,
-			     COAP_RESPONSE_CODE_CONTENT, id);
+			     fresh ? COAP_RESPONSE_CODE_CONTENT :
+			     COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE, id);
 		if (r < 0) {
 			goto end;
 		}
@@ -760,48 +847,31 @@ static int sensor_get(struct coap_resource *resource,
 			goto end;
 		}
 
-		r = coap_packet_append_payload_marker(&response);
+		//Max-Age: seconds the reading stays fresh (rounded up), or when to retry after 5.03
+		r = coap_append_option_int(&response, COAP_OPTION_MAX_AGE,
+					fresh ? (sensor_max_age - age + 999) / 1000 :
+					(sampling_period + 999) / 1000);
 		if (r < 0) {
 			goto end;
 		}
-		
-		char temp[10];
-		bool flag_distance = false;
-		if (strcmp((const char *)ssr_path0, (const char *)resource->path) == 0)
-		{
-			strcpy(temp, "Sensor 0");
-			if (distance_measure(dev1) == 0)
-			{
-				flag_distance = true;
-				r = snprintk((char *) payload, sizeof(payload),
-					"%s : %0.2f Inches", temp, curr_dist1);
-				if (r < 0) {
-					goto end;
-				}
-			}
+
+		r = coap_packet_append_payload_marker(&response);
+		if (r < 0) {
+			goto end;
 		}
-		else if (strcmp((const char *)ssr_path1, (const char *)resource->path) == 0)
+
+		if (fresh)
 		{
-			strcpy(temp, "Sensor 1");
-			if (distance_measure(dev2) == 0)
-			{
-				flag_distance = true;
-				r = snprintk((char *) payload, sizeof(payload),
-					"%s : %0.2f Inches", temp, curr_dist2);
-				if (r < 0) {
-					goto end;
-				}
-			}
-			
+			r = snprintk((char *) payload, sizeof(payload),
+				"%s : %0.2f Inches, %d ms old", temp, dist, (int)age);
 		}
-	
-		if (flag_distance == false)
+		else
 		{
 			//CoAP server response
 			r = snprintk((char *) payload, sizeof(payload), "Failed to get distance:");
-			if (r < 0) {
-				goto end;
-			}
+		}
+		if (r < 0) {
+			goto end;
 		}
 		r = coap_packet_append_payload(&response, (uint8_t *)payload,
 						strlen(payload));
@@ -813,10 +883,7 @@ static int sensor_get(struct coap_resource *resource,
 	}
 
 end:
-	if(data)
-	{
-		k_free(data);
-	}
+	coap_buf_free(data);
 	return r;
 }
 
@@ -845,8 +912,13 @@ static struct coap_resource resources[] = {
 	  .path = ssr_path1,
 	  .notify = sensor_notify,
 	},
-	{ .put = sensor_period_put,
-	  .path = ssr_period
+	{ .put = sensor_setting_put,
+	  .path = ssr_period,
+	  .user_data = &sampling_period
+	},
+	{ .put = sensor_setting_put,
+	  .path = ssr_max_age,
+	  .user_data = &sensor_max_age
 	},
 	{ .get = led_get,
       .put = led_put,
@@ -909,7 +981,7 @@ static void process_coap_request(uint8_t *data, uint16_t data_len,
 
 	/* Clear CoAP pending request */
 	if (type == COAP_TYPE_ACK) {
-		k_free(pending->data);
+		coap_buf_free(pending->data);
 		coap_pending_clear(pending);
 	}
 
@@ -971,52 +1043,240 @@ static int process_client_request(void)
 	return 0;
 }
 
-//Thread body which calculates the distance from 2 sensors
-extern void my_entry_point_1(void *p1, void *p2, void *p3)
+//Shell command "coap_bufs": response buffer pool usage, to size NUM_COAP_BUFS
+static int cmd_coap_bufs(const struct shell *shell, size_t argc, char **argv)
 {
-    int ret1, ret2;
-	double a, b;
-
-    while (1) {
-		//Measuring the distance from sensor1
-        ret1 = distance_measure(dev1);
-		a = sensor_value_to_double(&distance);
-		curr_dist1 = (float) a;
-		//Checking if observe is called or not
-		if(flag == 1 && sensor0_flag == 1 && resource_to_notify1)
-		{
-			if (curr_dist1 - prev_dist1 > 0.5)
-			{
-				coap_resource_notify(resource_to_notify1); //calling notify only when the disance > 0.5
-			}
-		}
-		prev_dist1 = curr_dist1;
-		k_msleep(25);
-
-		//Measuring the distance from sensor1
-		ret2 = distance_measure(dev2);
-		b = sensor_value_to_double(&distance);
-		curr_dist2 = (float) b;
-		//Checking if observe is called or not
-		if(flag == 1 && sensor1_flag == 1 && resource_to_notify2)
-		{
-			if (curr_dist2 - prev_dist2 > 0.5)
-			{
-				coap_resource_notify(resource_to_notify2); //calling notify only when the disance > 0.5
-			}
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(shell, "CoAP buffers: %u in use, %u free, peak %ld of %d, %ld failed",
+		    k_mem_slab_num_used_get(&coap_buf_slab),
+		    k_mem_slab_num_free_get(&coap_buf_slab),
+		    (long)atomic_get(&coap_buf_peak), NUM_COAP_BUFS,
+		    (long)atomic_get(&coap_buf_failed));
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(coap_bufs, NULL, "CoAP response buffer pool usage", cmd_coap_bufs);
+
+//Shell command "hcsr_rate": valid samples per second each sensor achieved lately
+static int cmd_hcsr_rate(const struct shell *shell, size_t argc, char **argv)
+{
+	struct sensor_value rate;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	for (int i = 0; i < NUM_SENSORS; i++) {
+		if (!ssr_dev[i] ||
+		    sensor_attr_get(ssr_dev[i], SENSOR_CHAN_DISTANCE,
+				    SENSOR_ATTR_SAMPLING_FREQUENCY, &rate) < 0) {
+			shell_print(shell, "HC-SR04_%d: no rate", i);
+			continue;
 		}
-		prev_dist2 = curr_dist2;
-		k_msleep(sampling_period); //sleeping the thread for user sampling period
-    }
-    LOG_INF("exiting");
+		shell_print(shell, "HC-SR04_%d: %d.%03d samples/s (period %d ms)", i,
+			    rate.val1, rate.val2 / 1000, sampling_period);
+	}
+
+	return 0;
 }
 
+SHELL_CMD_REGISTER(hcsr_rate, NULL, "HC-SR04 achieved sampling rates", cmd_hcsr_rate);
+
 //Defingin the thread stack area
-K_THREAD_STACK_ARRAY_DEFINE(my_stack_area, 2, MY_STACK_SIZE);
+K_THREAD_STACK_ARRAY_DEFINE(my_stack_area, 1, MY_STACK_SIZE);
 
 //Thread declarations
-struct k_thread my_thread_data[2];
-k_tid_t t_id_array[2];
+struct k_thread my_thread_data[1];
+k_tid_t t_id_array[1];
+
+//hcsr_jitter pauses the sampling thread between two rounds and resumes it when done
+static atomic_t sampling_paused;
+static K_SEM_DEFINE(sampling_idle, 0, 1);
+static K_SEM_DEFINE(sampling_resume, 0, 1);
+
+//Stops my_entry_point_1 after its current round so that nothing else triggers the sensors
+static void sampling_pause(void)
+{
+	if (!t_id_array[0]) {
+		return;
+	}
+	atomic_set(&sampling_paused, 1);
+	k_wakeup(t_id_array[0]);	//cuts the sleep between two rounds short
+	k_sem_take(&sampling_idle, K_FOREVER);
+}
+
+static void sampling_continue(void)
+{
+	if (!t_id_array[0]) {
+		return;
+	}
+	atomic_set(&sampling_paused, 0);
+	k_sem_give(&sampling_resume);
+}
+
+#define US_PER_INCH (2.0e6 / (340 * 40))	//echo time of one inch, as the driver converts it
+
+//Distance spread of one echo backend in hcsr_jitter
+struct jitter_stats {
+	int valid;
+	int failed;
+	double mean;
+	double m2;		//sum of squared differences from the mean (Welford)
+	double min;
+	double max;
+};
+
+static void jitter_run(const struct device *dev, int samples, int period,
+		       struct jitter_stats *st)
+{
+	struct sensor_value val;
+
+	memset(st, 0, sizeof(*st));
+	for (int i = 0; i < samples; i++) {
+		//An invalid echo fails the fetch with -EIO
+		if (sensor_sample_fetch(dev) == 0 &&
+		    sensor_channel_get(dev, SENSOR_CHAN_DISTANCE, &val) == 0) {
+			double d = sensor_value_to_double(&val);
+			double delta = d - st->mean;
+
+			st->valid++;
+			st->mean += delta / st->valid;
+			st->m2 += delta * (d - st->mean);
+			st->min = (st->valid == 1 || d < st->min) ? d : st->min;
+			st->max = (st->valid == 1 || d > st->max) ? d : st->max;
+		} else {
+			st->failed++;
+		}
+		k_msleep(period);
+	}
+}
+
+//Shell command "hcsr_jitter <sensor> [samples] [period_ms]": measures a fixed
+//target with each echo backend in turn and prints the spread of the distances
+static int cmd_hcsr_jitter(const struct shell *shell, size_t argc, char **argv)
+{
+	static const char * const names[] = { "gpio", "capture" };
+	const struct device *dev;
+	enum hc_sr04_backend saved;
+	struct jitter_stats st;
+	int s = atoi(argv[1]);
+	int samples = argc > 2 ? atoi(argv[2]) : 100;
+	int period = argc > 3 ? atoi(argv[3]) : 50;
+
+	if (s < 0 || s >= NUM_SENSORS || !ssr_dev[s] || samples < 2 || period < 0) {
+		shell_error(shell, "usage: hcsr_jitter <0..%d> [samples >= 2] [period_ms]",
+			    NUM_SENSORS - 1);
+		return -EINVAL;
+	}
+	dev = ssr_dev[s];
+	saved = hc_sr04_get_backend(dev);
+
+	sampling_pause();
+	shell_print(shell, "%s: %d samples every %d ms per backend, sampling paused",
+		    dev->name, samples, period);
+	for (int b = HC_SR04_BACKEND_GPIO; b <= HC_SR04_BACKEND_CAPTURE; b++) {
+		double sd;
+
+		if (hc_sr04_set_backend(dev, b) < 0) {
+			shell_print(shell, "%-8s not available", names[b]);
+			continue;
+		}
+		jitter_run(dev, samples, period, &st);
+		if (st.valid < 2) {
+			shell_print(shell, "%-8s %d valid of %d", names[b], st.valid, samples);
+			continue;
+		}
+		sd = sqrt(st.m2 / (st.valid - 1));
+		shell_print(shell, "%-8s %d valid of %d, mean %.3f in, stddev %.4f in (%.1f us), "
+			    "min %.3f max %.3f", names[b], st.valid, samples, st.mean, sd,
+			    sd * US_PER_INCH, st.min, st.max);
+	}
+
+	(void) hc_sr04_set_backend(dev, saved);
+	sampling_continue();
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(hcsr_jitter, NULL, "HC-SR04 distance spread per echo backend",
+		       cmd_hcsr_jitter, 2, 2);
+
+//Takes the result of a measurement of sensor s: caches it and notifies the observer
+static void sensor_sampled(int s, int status)
+{
+	struct sensor_value distance;
+
+	//A failed measurement keeps the last one
+	if (distance_read(ssr_dev[s], status, &distance) == 0)
+	{
+		curr_dist[s] = (float) sensor_value_to_double(&distance);
+		dist_cache_put(s, curr_dist[s]);	//served by sensor_get()
+	}
+	//Checking if observe is called or not
+	if(flag == 1 && sensor_flag[s] == 1 && resource_to_notify_s[s])
+	{
+		if (curr_dist[s] - prev_dist[s] > 0.5)
+		{
+			coap_resource_notify(resource_to_notify_s[s]); //calling notify only when the disance > 0.5
+		}
+	}
+	prev_dist[s] = curr_dist[s];
+}
+
+//Thread body which measures the distance of all sensors. Every round starts
+//them all without blocking, the driver staggers their triggers, and takes
+//each measurement as its signal is raised.
+extern void my_entry_point_1(void *p1, void *p2, void *p3)
+{
+	struct k_poll_signal done[NUM_SENSORS];
+	struct k_poll_event events[NUM_SENSORS];
+	unsigned int signaled;
+	int result;
+	int running;
+
+	for (int s = 0; s < NUM_SENSORS; s++) {
+		k_poll_signal_init(&done[s]);
+		k_poll_event_init(&events[s], K_POLL_TYPE_SIGNAL,
+				  K_POLL_MODE_NOTIFY_ONLY, &done[s]);
+	}
+
+	while (1) {
+		if (atomic_get(&sampling_paused)) {
+			k_sem_give(&sampling_idle);
+			k_sem_take(&sampling_resume, K_FOREVER);
+		}
+
+		running = 0;
+		for (int s = 0; s < NUM_SENSORS; s++) {
+			k_poll_signal_reset(&done[s]);
+			events[s].state = K_POLL_STATE_NOT_READY;
+			if (hc_sr04_fetch_signal(ssr_dev[s], &done[s]) == 0) {
+				running++;
+			} else {
+				LOG_WRN("%s: busy, skipped", ssr_dev[s]->name);
+			}
+		}
+
+		while (running > 0) {
+			(void) k_poll(events, NUM_SENSORS, K_FOREVER);
+			for (int s = 0; s < NUM_SENSORS; s++) {
+				if (events[s].state != K_POLL_STATE_SIGNALED) {
+					continue;
+				}
+				events[s].state = K_POLL_STATE_NOT_READY;
+				k_poll_signal_check(&done[s], &signaled, &result);
+				k_poll_signal_reset(&done[s]);
+				running--;
+				sensor_sampled(s, result);
+			}
+		}
+		if (!atomic_get(&sampling_paused)) {
+			k_msleep(sampling_period); //sleeping the thread for user sampling period
+		}
+	}
+	LOG_INF("exiting");
+}
 
 
 //Main function
@@ -1057,22 +1317,19 @@ void main(void)
 
 	//HC-SR04 sensor device bindings
 	#if CONFIG_HC_SR04
-	    dev1 = device_get_binding("HC-SR04_0");
-    	dev2 = device_get_binding("HC-SR04_1");
+	    ssr_dev[0] = device_get_binding("HC-SR04_0");
+    	ssr_dev[1] = device_get_binding("HC-SR04_1");
 	#endif
 
-    if (dev1 == NULL) {
-        LOG_ERR("Failed to get dev1 binding");
-        return;
-    }
-    if (dev2 == NULL) {
-        LOG_ERR("Failed to get dev2 binding");
-        return;
-    }
-    LOG_INF("dev is %p, name is %s", dev1, dev1->name);
-    LOG_INF("dev is %p, name is %s", dev2, dev2->name);
+	for (int i = 0; i < NUM_SENSORS; i++) {
+		if (ssr_dev[i] == NULL) {
+			LOG_ERR("Failed to get HC-SR04_%d binding", i);
+			return;
+		}
+		LOG_INF("dev is %p, name is %s", ssr_dev[i], ssr_dev[i]->name);
+	}
 
-	//Creating threads for sensor values
+	//Creating thread for the sensor values of all sensors
 	DPRINTK("Creating thread for running the sensor values");
 	t_id_array[0] = k_thread_create(&my_thread_data[0], my_stack_area[0],
                                  MY_STACK_SIZE,
@@ -0,0 +1,28 @@
+#ifndef __ARRIVAL_TRACE_H__
+#define __ARRIVAL_TRACE_H__
+
+/*
+ * Recorded request arrivals replayed by ARR_TRACE, included by arrivals.c
+ * only. One {gap_us, iterations} pair per request, the gap counted from
+ * the previous arrival; a loop count of 0 stands for the loop count of
+ * the server the request is drawn for (REQ_LOOP for APS0). The table
+ * is replayed from the start until the run is covered.
+ *
+ * The sample below is a quiet stretch, a burst of back to back requests
+ * and a few long ones. To replay another load, put the differences of the
+ * EVT_REQ_ARRIVAL timestamps of an event trace here.
+ */
+
+#include "arrivals.h"
+
+static const struct arrival arrival_trace[] = {
+    {38000, 0}, {41000, 0}, {36500, 0}, {44000, 0},
+    {39500, 0}, {40000, 0}, {35000, 0}, {42500, 0},
+    {6000, 0}, {4500, 0}, {5200, 0}, {3900, 0},
+    {4800, 0}, {6100, 0}, {5000, 0}, {4400, 0},
+    {52000, 2500000}, {61000, 0}, {47000, 2500000}, {39000, 0},
+    {120000, 0}, {2000, 420000}, {2100, 420000}, {1900, 420000},
+    {2000, 420000}, {45000, 0}, {37000, 0}, {43000, 0},
+};
+
+#endif // __ARRIVAL_TRACE_H__
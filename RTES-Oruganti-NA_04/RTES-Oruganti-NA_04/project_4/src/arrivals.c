@@ -0,0 +1,184 @@
+/*
+* Arrival schedule of the aperiodic requests, see arrivals.h.
+*
+* The generators only use integer math: the exponential draws take
+* -ln(u) in 16.16 fixed point from a base 2 logarithm, so no libm or
+* floating point is needed.
+*/
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/util.h>
+#define TASK_MODEL_TYPES_ONLY       // the task set variables are defined by main.c
+#include "arrivals.h"
+#include "arrival_trace.h"
+
+#define LN2_Q16 45426           // ln(2) in 16.16
+#define U_BITS 24               // resolution of the uniform draws of rand_exp()
+
+const char * const arr_mode_names[ARR_MODES] = ARR_MODE_NAMES;
+
+static struct arrival schedule[ARR_SCHEDULE_MAX];
+static struct arrival_info info;
+static uint32_t rng;
+
+static struct
+{
+    uint64_t now_us;            // last arrival
+    uint64_t state_end_us;      // end of the calm period or burst
+    bool burst;
+} mmpp;
+
+//uniform between base * (100 - var) / 100 and base, the integer form of the old rand_dist()
+static uint32_t rand_spread(uint32_t base, uint32_t var)
+{
+    uint32_t range = (uint64_t)base * var / 100;
+
+    if (range == 0)
+    {
+        return base;
+    }
+    return base - range + xorshift32(&rng) % range;
+}
+
+//log2(x) in 16.16 for x >= 1: the integer part is the top bit, each squaring of the mantissa gives a fraction bit
+static uint32_t log2_q16(uint32_t x)
+{
+    uint32_t ip = 31 - __builtin_clz(x);
+    uint64_t y = (uint64_t)x << (31 - ip);      //mantissa in [1, 2) as 1.31
+    uint32_t frac = 0;
+
+    for (int bit = 15; bit >= 0; bit--)
+    {
+        y = (y * y) >> 31;
+        if (y >= (1ULL << 32))
+        {
+            y >>= 1;
+            frac |= 1U << bit;
+        }
+    }
+    return (ip << 16) | frac;
+}
+
+//exponential with the given mean: -mean * ln(u), u uniform in (0, 1]
+static uint32_t rand_exp(uint32_t mean)
+{
+    uint32_t u = (xorshift32(&rng) >> (32 - U_BITS)) + 1;      //u * 2^U_BITS, 1 to 2^U_BITS
+    uint64_t neg_ln = ((uint64_t)((U_BITS << 16) - log2_q16(u)) * LN2_Q16) >> 16;
+
+    return MAX((mean * neg_ln) >> 16, 1);
+}
+
+/*
+* Two state Markov-modulated Poisson process. The state is kept between
+* calls; a dwell time drawn past the next arrival ends the state, and as
+* both are exponential the arrival is drawn again from the switch.
+*/
+static uint32_t rand_bursty(void)
+{
+    uint64_t last_us = mmpp.now_us;
+    uint64_t next_us;
+
+    for (;;)
+    {
+        next_us = mmpp.now_us + rand_exp(mmpp.burst ? ARR_TIME / ARR_BURST_RATE : ARR_TIME);
+        if (next_us <= mmpp.state_end_us)
+        {
+            break;
+        }
+        mmpp.now_us = mmpp.state_end_us;
+        mmpp.burst = !mmpp.burst;
+        info.bursts += mmpp.burst;
+        mmpp.state_end_us = mmpp.now_us + rand_exp((mmpp.burst ? ARR_BURST_MS : ARR_CALM_MS) * 1000);
+    }
+
+    mmpp.now_us = next_us;
+    return next_us - last_us;
+}
+
+static uint32_t next_gap(enum arr_mode mode, uint32_t n)
+{
+    switch (mode)
+    {
+    case ARR_POISSON:
+        return rand_exp(ARR_TIME);
+    case ARR_BURSTY:
+        return rand_bursty();
+    case ARR_TRACE:
+        return arrival_trace[n % ARRAY_SIZE(arrival_trace)].gap_us;
+    default:
+        return rand_spread(ARR_TIME, ARR_VAR);
+    }
+}
+
+//class in proportion to the weights, a single class draws nothing so its schedule does not change
+static uint8_t next_class(const struct task_aps *classes, int num_classes)
+{
+    uint32_t total = 0;
+    uint32_t r;
+    int i;
+
+    if (num_classes <= 1)
+    {
+        return 0;
+    }
+    for (i = 0; i < num_classes; i++)
+    {
+        total += classes[i].weight;
+    }
+    r = xorshift32(&rng) % MAX(total, 1);
+    for (i = 0; i < num_classes - 1 && r >= classes[i].weight; i++)
+    {
+        r -= classes[i].weight;
+    }
+    return i;
+}
+
+static uint32_t next_iterations(enum arr_mode mode, uint32_t n, const struct task_aps *cls)
+{
+    if (mode == ARR_TRACE && arrival_trace[n % ARRAY_SIZE(arrival_trace)].iterations)
+    {
+        return arrival_trace[n % ARRAY_SIZE(arrival_trace)].iterations;
+    }
+    return rand_spread(cls->req_loop, REQ_VAR);
+}
+
+//Called by main() before the request timer starts
+void arrivals_init(enum arr_mode mode, uint32_t seed, const struct task_aps *classes, int num_classes)
+{
+    uint64_t end_us = (uint64_t)TOTAL_TIME * 1000;
+
+    rng = seed ? seed : 1;
+    info.len = 0;
+    info.span_us = 0;
+    info.bursts = 0;
+    mmpp.now_us = 0;
+    mmpp.burst = false;
+    if (mode == ARR_BURSTY)
+    {
+        mmpp.state_end_us = rand_exp(ARR_CALM_MS * 1000);      //the run starts calm
+    }
+
+    while (info.len < ARR_SCHEDULE_MAX && info.span_us <= end_us)
+    {
+        struct arrival *a = &schedule[info.len];
+
+        a->gap_us = next_gap(mode, info.len);
+        a->cls = next_class(classes, num_classes);
+        a->iterations = next_iterations(mode, info.len, &classes[a->cls]);
+        info.span_us += a->gap_us;
+        info.len++;
+    }
+    info.repeats = info.span_us <= end_us;
+}
+
+//Request n of the run, safe in the timer interrupt
+const struct arrival *arrivals_get(uint32_t n)
+{
+    return &schedule[n % info.len];
+}
+
+void arrivals_info(struct arrival_info *out)
+{
+    *out = info;
+}
@@ -0,0 +1,64 @@
+#ifndef __ARRIVALS_H__
+#define __ARRIVALS_H__
+
+/*
+ * Arrival schedule of the aperiodic requests.
+ *
+ * arrivals_init() draws the interarrival times and loop counts of the whole
+ * run into a preallocated buffer before the request timer starts, so the
+ * timer interrupt only reads the next entry and the generator costs nothing
+ * during the measurement. The schedule is long enough for TOTAL_TIME or
+ * ARR_SCHEDULE_MAX requests; past its end it starts over.
+ *
+ * ARR_UNIFORM keeps the original uniform interarrival times, ARR_POISSON
+ * draws exponential ones, ARR_BURSTY switches between a calm and a burst
+ * rate after exponential dwell times (a two state Markov-modulated Poisson
+ * process) and ARR_TRACE replays arrival_trace.h. The random modes use
+ * xorshift32 seeded with ARR_SEED, so a run can be repeated exactly.
+ *
+ * With several servers every arrival is also given a request class, drawn
+ * in proportion to the weights of the servers; the class selects the
+ * server, its queue and the loop count of the request.
+ */
+
+#include <zephyr.h>
+#include "task_model_p4_new.h"
+
+#ifndef ARR_SCHEDULE_MAX
+#define ARR_SCHEDULE_MAX 512    // requests in the schedule
+#endif
+
+struct arrival
+{
+    uint32_t gap_us;            // time since the previous arrival, or since the start of the run
+    uint32_t iterations;        // loop count of the request
+    uint8_t cls;                // request class, the server of the request
+};
+
+struct arrival_info
+{
+    uint32_t len;               // requests in the schedule
+    uint64_t span_us;           // arrival time of the last one
+    uint32_t bursts;            // ARR_BURSTY: bursts started
+    bool repeats;               // the schedule ends before TOTAL_TIME
+};
+
+//Marsaglia's xorshift32, state must not be 0
+static inline uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void arrivals_init(enum arr_mode mode, uint32_t seed, const struct task_aps *classes, int num_classes);
+const struct arrival *arrivals_get(uint32_t n);
+void arrivals_info(struct arrival_info *info);
+
+extern const char * const arr_mode_names[ARR_MODES];
+
+#endif // __ARRIVALS_H__
@@ -5,7 +5,9 @@
 * This program tries to implement a 
 * Polling server in order to serve 
 * the aperiodic request arrived with 
-* periodic tasks. 
+* periodic tasks. The deferrable, sporadic
+* and total bandwidth servers of server.c
+* can be selected with SERVER.
 */
 
 #include <zephyr.h>
@@ -19,60 +21,92 @@
 #include <stdbool.h>
 #include <sys/arch_interface.h>
 #include "task_model_p4_new.h"
+#include "evtrace.h"
+#include "server.h"
+#include "reqstats.h"
+#include "slack.h"
+#ifdef CONFIG_ARCH_POSIX
+#include <posix_board_if.h>
+#endif
+
+#define POLL_TRACE_ID(i) (NUM_THREADS + (i))    // thread id of server i in the event trace
+BUILD_ASSERT(BG_PRIO < K_LOWEST_APPLICATION_THREAD_PRIO, "BG_PRIO: background service would share a priority with the trace drain thread");
 
 //Periodic threads and thread Ids
 static struct k_thread my_thread_data[NUM_THREADS];
 static k_tid_t thread_ids[NUM_THREADS];
 
-//Polling server thread and Id
-struct k_thread polling_thread_data;
-static k_tid_t polling_tid;
+//Aperiodic server threads and Ids
+struct k_thread polling_thread_data[NUM_SERVERS];
+static k_tid_t polling_tid[NUM_SERVERS];
+static struct aps_server aps[NUM_SERVERS];      //budget state of the servers, see server.c
+BUILD_ASSERT(NUM_SERVERS <= APS_SERVERS && NUM_SERVERS <= MAX_SERVERS, "NUM_SERVERS: servers without a table entry");
+BUILD_ASSERT(SERVER != SERVER_SLACK || NUM_SERVERS == 1, "SERVER_SLACK: the slack table leaves out a second server");
 
 //Periodic task signals 
 static int my_thread_idx[NUM_THREADS];
 static int complete_flag[NUM_THREADS];
 static struct k_sem waiting_sem[NUM_THREADS];
+static uint32_t release_cyc[NUM_THREADS];  // release time of the current job
+static uint32_t job_count[NUM_THREADS];    // jobs started per task
+static int64_t release_origin;              // uptime in ticks of the first release of all tasks
+
+//Overrun handling of the periodic tasks
+struct overrun_info {
+    uint32_t misses;            // releases that found the previous job unfinished
+    uint32_t skipped;           // releases dropped by OVR_SKIP
+    uint32_t aborted;           // jobs stopped by OVR_ABORT
+    uint32_t demoted;           // jobs finished at DEMOTE_PRIO
+    uint32_t degraded;          // jobs run with DEGRADE_PERCENT of their iterations
+    uint32_t cascade_misses;    // misses while another task was overrunning
+    volatile bool abort_job;
+    volatile bool demote_job;
+    int degrade_left;
+};
+static struct overrun_info ovr[NUM_THREADS];
+static atomic_t overrun_mask;   // tasks whose current job is past its deadline, one bit each
+static const char * const overrun_names[OVR_POLICIES] = OVERRUN_POLICY_NAMES;
 
 //Thread stack definition
 static K_THREAD_STACK_DEFINE(thread_stack_area, STACK_SIZE * NUM_THREADS);
-static K_THREAD_STACK_DEFINE(polling_stack_area, STACK_SIZE);
-
-//Worker Queue structure
-struct thread_priority_info {
-    struct k_work work;
-    int priority;
-} my_polling_thread;
-
-//Timers for aperiodic computations
-struct k_timer remaining_budget_timer;
-struct k_timer replenishing_timer;
+static K_THREAD_STACK_ARRAY_DEFINE(polling_stack_area, NUM_SERVERS, STACK_SIZE);
 
-//Global variable for the polling server info
-struct task_aps *gpoll_info;
-
-//For calculating the average response time
-uint64_t average_response_time = 0;
-int total_requests = 0;
+//Response time split into queueing (arrival to start) and service (start to end), in nanoseconds;
+//the response time of every request is recorded by reqstats.c
+uint64_t total_queueing_time = 0, max_queueing_time = 0;
+uint64_t total_service_time = 0, max_service_time = 0;
+int total_requests = 0;     //requests served
+static struct k_spinlock totals_lock;   //the servers preempt each other updating the totals
 
 //Flag used for exiting the while loops
 static bool run_thread_flag = true;
 
+//End of the run: the servers finish the request in service and serve the queued ones until drain_deadline
+struct drain_info {
+    uint32_t queued;            // requests waiting when the run ended
+    bool in_service;            // a request was being served
+    uint32_t served;            // requests finished after the end of the run
+    uint32_t cancelled;         // requests still queued at the drain deadline
+    uint32_t time_us;           // end of the run to the exit of the server thread
+    bool aborted;               // the server thread did not exit in time and was aborted
+};
+static struct drain_info drain[NUM_SERVERS];
+static int64_t drain_start, drain_deadline;     // uptime in ticks
+
 /*
 * Aperiodic switched in function. 
 *
 * This function helps to track the budget. When the context switch in happens, 
-* it checks the thread id is same as polling server id. 
-* If it is same, then it starts a timer for the left over budget. 
+* it reads the server of the current thread from its custom data (set by server_init()).
+* If the thread is a server, the server starts a timer for the left over budget. 
 */
 void aperiodic_switched_in(void)
 {
-    static k_tid_t curr_thrd_id;
-    curr_thrd_id = k_current_get();  //read the current thread id
+    struct aps_server *server = k_thread_custom_data_get();    //NULL for every other thread
     
-    if((curr_thrd_id == polling_tid)& (gpoll_info->left_budget > 0))  //If it is same as polling server, then start the timer for remaining budget
+    if(server != NULL)  //the thread of an aperiodic server, start the timer for remaining budget
     {
-        k_timer_start(&remaining_budget_timer, K_NSEC(gpoll_info->left_budget), K_NO_WAIT);
-        gpoll_info->last_switched_in = k_cycle_get_32();
+        server_switched_in(server);
     }   
 }
 
@@ -80,21 +114,122 @@ void aperiodic_switched_in(void)
 * Aperiodic switched out function.
 * 
 * When the context switch out happens, it checks if the 
-* exited thread is polling server and then stops the above timer
+* exited thread is a server and then stops the above timer
 * and the left over budget is changed to remaining timer count. 
 */
 void aperiodic_switched_out(void)
 {
-	static k_tid_t curr_thrd_id;
-    curr_thrd_id = k_current_get(); // read the current thread id
+    struct aps_server *server = k_thread_custom_data_get();
 
-    if(curr_thrd_id == polling_tid)  //If it is same as polling server, then stop the timer and update left_budget
+    if(server != NULL)  //the thread of an aperiodic server, stop the timer and update left_budget
     {
-        k_timer_stop(&remaining_budget_timer);
-        gpoll_info->left_budget = 1000000*k_timer_remaining_get(&remaining_budget_timer);
+        server_switched_out(server);
     }   
 }
 
+#ifdef CONFIG_TRACING_USER
+/*
+* Zephyr's user tracing hooks (CONFIG_TRACING_USER of the bench boards).
+* Without SystemView no patched kernel is needed for the budget
+* accounting, the scheduler calls these on every context switch.
+*/
+void sys_trace_thread_switched_in_user(struct k_thread *thread)
+{
+    aperiodic_switched_in();
+}
+
+void sys_trace_thread_switched_out_user(struct k_thread *thread)
+{
+    aperiodic_switched_out();
+}
+#endif
+
+/*
+* Overrun handling.
+*
+* Called from the release timer when the job of the last period is still
+* running. Only flags are set here, the task itself aborts or demotes its
+* job between two chunks of its loop.
+*/
+static void handle_overrun(int id)
+{
+    if (atomic_get(&overrun_mask) & ~BIT(id))
+    {
+        ovr[id].cascade_misses++;   //another task's overrun may have caused this miss
+    }
+    atomic_set_bit(&overrun_mask, id);
+
+    ovr[id].misses++;
+    evtrace_log(EVT_OVERRUN, id, threads[id].overrun);
+
+    switch (threads[id].overrun)
+    {
+    case OVR_SKIP:
+        ovr[id].skipped++;      //no semaphore, the late job does not start another one right away
+        return;
+    case OVR_ABORT:
+        ovr[id].abort_job = true;
+        break;
+    case OVR_DEMOTE:
+        ovr[id].demote_job = true;
+        break;
+    case OVR_DEGRADE:
+        ovr[id].degrade_left = DEGRADE_JOBS;
+        break;
+    default:
+        break;
+    }
+    k_sem_give(&waiting_sem[id]);
+}
+
+/*
+* Runs one job of a periodic task in chunks of about a millisecond, so an
+* overrun flag set by the release timer is seen while the job runs.
+* Returns false when the job was aborted.
+*/
+static bool run_job(int id, const struct task_s *task_info)
+{
+    uint32_t total = task_info->loop_iter;
+    uint32_t chunk = LOOP_UNIT_US ? 1000 : MAX(workload_iter_per_ms(TASK_WORKLOAD), 1);
+    bool demoted = false;
+    bool done = true;
+
+    if (ovr[id].degrade_left > 0)
+    {
+        ovr[id].degrade_left--;
+        ovr[id].degraded++;
+        total = total * DEGRADE_PERCENT / 100;
+    }
+
+    for (uint32_t i = 0; i < total; i += chunk)
+    {
+        if (ovr[id].abort_job)
+        {
+            ovr[id].aborted++;
+            evtrace_log(EVT_JOB_ABORT, id, job_count[id]);
+            done = false;
+            break;
+        }
+        if (ovr[id].demote_job && !demoted)
+        {
+            ovr[id].demoted++;
+            demoted = true;
+            k_thread_priority_set(k_current_get(), DEMOTE_PRIO);
+        }
+        looping(TASK_WORKLOAD, MIN(chunk, total - i));      //looping computation task.
+    }
+
+    if (demoted)
+    {
+        k_thread_priority_set(k_current_get(), task_info->priority);
+    }
+    ovr[id].abort_job = false;
+    ovr[id].demote_job = false;
+    atomic_clear_bit(&overrun_mask, id);
+
+    return done;
+}
+
 //Periodic threads timer expiry function for deadline misses
 static void timer_expiry_function(struct k_timer *timer_exp)
 {
@@ -106,89 +241,111 @@ static void timer_expiry_function(struct k_timer *timer_exp)
     {
         k_sem_give(&waiting_sem[id]); 
     }
-    else                //else update the deadline missing and give the semaphore
+    else                //else update the deadline missing and apply the overrun policy of the task
     {
-        printk("Task %d missed its deadline\n", id);
-        k_sem_give(&waiting_sem[id]);
+        evtrace_log(EVT_DEADLINE_MISS, id, job_count[id]);    //printed by the trace drain thread, not in timer context
+        handle_overrun(id);
     }
+    release_cyc[id] = k_cycle_get_32();
+    evtrace_log(EVT_RELEASE, id, job_count[id] + 1);
 }
 
-//polling server local timer expiry function
-/*
-* When the budget is finished, the polling server goes to
-* background mode by setting the priority to 14. 
-*/
-static void local_timer_expiry_func(struct k_timer *loc_timer_exp)
+//estimated execution time of a request, the budget of a total bandwidth server request
+static int64_t req_cost_ns(const struct req_type *req)
 {
-    //k_thread_priority_set(polling_tid, 14);
-    gpoll_info->left_budget = 0;
-    my_polling_thread.priority = 14;
-    k_work_submit(&my_polling_thread.work);     //submit the priority to worker queue
+#if LOOP_UNIT_US
+    return (int64_t)1000 * req->iterations;
+#else
+    return (int64_t)1000000 * req->iterations / MAX(workload_iter_per_ms(REQ_WORKLOAD), 1);
+#endif
 }
 
-//replenishing the budget
-/*
-* When the timer is expired, replenish the budget and restore back the priority.
-*/
-static void replenishing_timer_exp_func(struct k_timer *repl_timer_exp)
+//execution time of a job of a periodic task, for the slack table
+static uint32_t task_exec_us(const struct task_s *task_info)
 {
-    gpoll_info->left_budget = 1000000*BUDGET;
-    my_polling_thread.priority = POLL_PRIO;
-    k_work_submit(&my_polling_thread.work);     //submit the priority to worker queue
+#if LOOP_UNIT_US
+    return task_info->loop_iter;
+#else
+    return (uint64_t)1000 * task_info->loop_iter / MAX(workload_iter_per_ms(TASK_WORKLOAD), 1);
+#endif
 }
 
-//set priority
-/*
-* This function is the worker queue handler function
-* which sets the priority when the timer handler is expired
-*/
-void set_thread_priority(struct k_work *item)
+//Builds the slack table of the periodic tasks, before they start
+static void slack_setup(void)
 {
-    struct thread_priority_info *the_thread_prio = CONTAINER_OF(item, struct thread_priority_info, work);
-    k_thread_priority_set(polling_tid, the_thread_prio->priority);
+    k_tid_t tids[NUM_THREADS];
+    uint32_t exec_us[NUM_THREADS];
+    struct slack_info sl;
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        tids[i] = &my_thread_data[i];       //the thread ids k_thread_create() will return
+        exec_us[i] = task_exec_us(&threads[i]);
+    }
+    if (slack_init(threads, tids, exec_us, NUM_THREADS) != 0) {
+        printk("Slack table: more than %d jobs in the hyperperiod, no slack stealing\n", SLACK_TABLE_MAX);
+        return;
+    }
+    slack_info(&sl);
+    printk("Slack table: hyperperiod %llu ms, %u jobs, execution times +%d%%%s\n", sl.hyper_us / 1000, sl.jobs,
+           SLACK_MARGIN, sl.misses ? ", the tasks miss deadlines, no slack" : "");
+    for (int k = 0; k < NUM_THREADS; k++) {
+        printk("  level %d: %llu ms idle per hyperperiod\n", k, sl.idle_us[k] / 1000);
+    }
 }
 
 //Polling server entry point function
-static void polling_entry_point(void *v_poll_info, void *v_poll_prio, void *unused)
+/*
+* The budget and the priority of the server are managed by server.c,
+* the thread only serves the requests of its class. One thread per server.
+*/
+static void polling_entry_point(void *v_server, void *v_drain, void *unused2)
 {
-
-    printk("\nInside Polling server\n");
-    struct task_aps *my_poll_info = (struct task_aps *)v_poll_info;
-    gpoll_info = my_poll_info;      //global variable 
-
+    struct aps_server *server = (struct aps_server *)v_server;
+    struct drain_info *drain = (struct drain_info *)v_drain;
     struct req_type data;
-    uint32_t end_time;
-    uint64_t current_response_time;
+    uint32_t start_time, end_time;
+    uint64_t queueing_time, service_time;
+    k_spinlock_key_t key;
 
     int ret; 
 
-    //replenishing the budget
-    k_timer_init(&replenishing_timer, replenishing_timer_exp_func, NULL);
-    k_timer_start(&replenishing_timer, K_MSEC(my_poll_info->period), K_MSEC(my_poll_info->period));
-
-    //Initiating the worker queue
-    k_work_init(&my_polling_thread.work, set_thread_priority);
-
     printk("Reading the message queue\n");
-    while(run_thread_flag)
+    while(1)
     {
-        //reading the message queue
-        ret = k_msgq_get(&req_msgq, &data, K_FOREVER);  
+        //reading the message queue, the server suspends when it is empty
+        ret = server_next(server, &data, K_FOREVER);
+        if(ret == -ESHUTDOWN)   //end of the run and nothing left to serve
+        {
+            break;
+        }
         if(ret == 0)  //check if there are messages in the polling server queue
         {
-            k_thread_priority_set(polling_tid, POLL_PRIO);
-            looping(data.iterations);           //Aperiodic calculations
+            server_begin(server, &data);
+            start_time = k_cycle_get_32();
+            evtrace_log(EVT_REQ_START, server->trace_id, data.id);
+            looping(REQ_WORKLOAD, data.iterations);           //Aperiodic calculations
             end_time = k_cycle_get_32();
-            current_response_time = timing_cycles_to_ns(sub32(data.arr_time, end_time));
-            average_response_time = average_response_time + current_response_time;
-            total_requests = data.id +1; 
+            evtrace_log(EVT_REQ_DONE, server->trace_id, data.id);
+            server_end(server);
+            reqstats_add(&data, start_time, end_time);
+            queueing_time = timing_cycles_to_ns(sub32(data.arr_time, start_time));
+            service_time = timing_cycles_to_ns(sub32(start_time, end_time));
+            key = k_spin_lock(&totals_lock);
+            total_queueing_time += queueing_time;
+            total_service_time += service_time;
+            max_queueing_time = MAX(max_queueing_time, queueing_time);
+            max_service_time = MAX(max_service_time, service_time);
+            total_requests++;
+            k_spin_unlock(&totals_lock, key);
         }   
-        else        //if there are no messages in queue, change the budget to 0 and priority to background mode
+        if(!run_thread_flag && k_uptime_ticks() >= drain_deadline)    //no time left for the queued requests
         {
-            gpoll_info->left_budget = 0;
-            k_thread_priority_set(polling_tid, 14);
-        }  
+            break;
+        }
     }
+
+    drain->cancelled = reqq_flush(server->queue);
+    drain->time_us = k_ticks_to_us_floor64(k_uptime_ticks() - drain_start);
     return;
 }
 
@@ -209,16 +366,26 @@ static void thread(void *v_task_info, void *v_thread_id, void *unused)
     printk("\nTask Id: %d started\nPeriod: %d\nPriority: %d\n\n", thread_id, task_info->period, task_info->priority);
 
 	period = 1000000*task_info->period; 
-    k_timer_start(&task_timer,K_NSEC(period), K_NSEC(period));  //starting the timer
+    release_cyc[thread_id] = k_cycle_get_32();     //the first job is released at release_origin, with all others
+    k_timer_start(&task_timer, K_TIMEOUT_ABS_TICKS(release_origin + k_ms_to_ticks_ceil64(task_info->period)),
+                  K_NSEC(period));  //starting the timer, in phase with the other tasks
 
     while (run_thread_flag) 
     {     
         complete_flag[thread_id]=0;
-        looping(task_info->loop_iter);      //looping computation task.
+        job_count[thread_id]++;
+        evtrace_log(EVT_JOB_START, thread_id, k_cyc_to_us_floor32(k_cycle_get_32() - release_cyc[thread_id]));
+        if (run_job(thread_id, task_info))
+        {
+            evtrace_log(EVT_JOB_END, thread_id, k_cyc_to_us_floor32(k_cycle_get_32() - release_cyc[thread_id]));
+        }
         complete_flag[thread_id]=1;
+        slack_job_end(thread_id);       //the slack of the next job is available
+        server_slack_check();
 
         k_sem_take(&waiting_sem[thread_id], K_FOREVER);
     }
+    k_timer_stop(&task_timer);      //on this stack: no releases after the run
 }
 
 // Start all threads defined in the task set
@@ -229,7 +396,9 @@ static void start_threads(void)
         complete_flag[i]=0;
     }
 
-    // Start each periodic task thread
+    // Start each periodic task thread, all released together (critical instant, as in the slack table)
+    release_origin = k_uptime_ticks() + k_ms_to_ticks_ceil64(10);
+    slack_start(release_origin);
     for (int i = 0; i < NUM_THREADS; i++) {
 		my_thread_idx[i]=i;
         thread_ids[i] = k_thread_create(&my_thread_data[i],
@@ -237,44 +406,86 @@ static void start_threads(void)
                                          STACK_SIZE * sizeof(k_thread_stack_t),
                                          thread, (void *)&threads[i],
                                          (void *)&my_thread_idx[i], NULL, threads[i].priority,
-                                         0, K_MSEC(10));
+                                         0, K_TIMEOUT_ABS_TICKS(release_origin));
 
         k_thread_name_set(thread_ids[i], threads[i].t_name);        //setting the thread name
+        evtrace_name_set(i, threads[i].t_name);
         printk("\nCreating thread %d.\n", i);       
 
     }
 
-    //Starting the polling server thread
-    polling_tid = k_thread_create(&polling_thread_data, polling_stack_area,
-                                 K_THREAD_STACK_SIZEOF(polling_stack_area),
-                                 polling_entry_point,
-                                 (void *)&poll_info, 0, NULL,
-                                 POLL_PRIO, 0, K_MSEC(10));
-
-    k_thread_name_set(polling_tid, poll_info.t_name);           //setting the polling server thread
+    //Starting the aperiodic server threads
+    for (int i = 0; i < NUM_SERVERS; i++) {
+        polling_tid[i] = k_thread_create(&polling_thread_data[i], polling_stack_area[i],
+                                        K_THREAD_STACK_SIZEOF(polling_stack_area[i]),
+                                        polling_entry_point,
+                                        (void *)&aps[i], (void *)&drain[i], NULL,
+                                        poll_info[i].priority, 0, K_MSEC(10));
+
+        k_thread_name_set(polling_tid[i], poll_info[i].t_name);     //setting the server thread name
+        evtrace_name_set(POLL_TRACE_ID(i), poll_info[i].t_name);
+
+        //budget and replenishment of the server, before its thread starts
+        poll_info[i].poll_tid = polling_tid[i];
+        server_init(&aps[i], poll_info[i].kind, &poll_info[i], &req_queue[i], req_cost_ns, POLL_TRACE_ID(i));
+        printk("Server %s: %s, priority %d, budget %d ms every %d ms, weight %d of the requests\n",
+               poll_info[i].t_name, server_names[poll_info[i].kind], poll_info[i].priority, poll_info[i].budget,
+               poll_info[i].period, poll_info[i].weight);
+    }
 }
 
 
 //Main Function - Entry point
 void main(void)
 {
+    struct rt_summary rt;
+    struct arrival_info arr;
+
     //Sleeping the main for 5 secs to record the proper data in systemview.
     //k_sleep(K_MSEC(10000));
 
+    //Timing the busy work kernels before any task runs
+    workload_init();
+    printk("Workload: %u alu, %u mem, %u cache iterations per ms\n", workload_iter_per_ms(WL_ALU),
+           workload_iter_per_ms(WL_MEMORY), workload_iter_per_ms(WL_CACHE));
+
+    //The request queues and the response time records, before the servers and the request timer use them
+    for (int i = 0; i < NUM_SERVERS; i++) {
+        reqq_init(&req_queue[i], REQ_ORDER, req_cost_ns);
+    }
+    reqstats_reset();
+    slack_setup();
+
+    //Every arrival of the run drawn now, the request timer only reads the schedule
+    arrivals_init(ARR_MODE, ARR_SEED, poll_info, NUM_SERVERS);
+    arrivals_info(&arr);
+    printk("Arrivals: %s, %u requests over %llu ms%s\n", arr_mode_names[ARR_MODE], arr.len, arr.span_us / 1000,
+           arr.repeats ? ", repeated until the end of the run" : "");
+
     // Spawning the polling server and all periodic threads
     start_threads();
 
-    //Starting a timer for replenishing the budget
-    k_timer_init(&remaining_budget_timer, local_timer_expiry_func, NULL);
-    
     //Starting the message request timer
-    k_timer_start(&req_timer, K_USEC(ARR_TIME), K_NO_WAIT);
+    evtrace_log(EVT_RUN_START, EVT_NO_THREAD, TOTAL_TIME);
+    k_timer_start(&req_timer, K_USEC(arrivals_get(0)->gap_us), K_NO_WAIT);
 
     //Put the main thread for total period. 
     k_sleep(K_MSEC(TOTAL_TIME));
 
+    //Stopping the request generator first, no request arrives after the end of the run
+    k_timer_stop(&req_timer);
+    drain_start = k_uptime_ticks();
+    drain_deadline = drain_start + k_ms_to_ticks_ceil64(DRAIN_TIME);
+    for (int i = 0; i < NUM_SERVERS; ++i) {
+        drain[i].queued = reqq_num_used(&req_queue[i]);
+        drain[i].in_service = aps[i].busy;
+        drain[i].served = aps[i].stats.served;      //made the difference below
+        reqq_close(&req_queue[i]);      //wakes a waiting server, which exits once its queue is empty
+    }
+
     //Exiting the while loop
     run_thread_flag = false;
+    evtrace_log(EVT_RUN_END, EVT_NO_THREAD, 0);
 
     //give the semaphore for waiting threads
     for (int i = 0; i < NUM_THREADS; ++i) {
@@ -286,16 +497,104 @@ void main(void)
         k_thread_join(&my_thread_data[i],K_FOREVER);
         printk("Terminating Thread %d\n", i);
     }
-    //terminating the polling server
-    k_thread_abort(polling_tid);
-    k_timer_stop(&remaining_budget_timer);
-    k_timer_stop(&replenishing_timer);
-    k_timer_stop(&req_timer);
+    //Waiting for the aperiodic servers to drain their queues; the request in service at the deadline
+    //may take up to DRAIN_TIME more before the server is aborted
+    for (int i = 0; i < NUM_SERVERS; ++i) {
+        if (k_thread_join(&polling_thread_data[i],
+                          K_TIMEOUT_ABS_TICKS(drain_deadline + k_ms_to_ticks_ceil64(DRAIN_TIME))) != 0) {
+            k_thread_abort(polling_tid[i]);
+            drain[i].aborted = true;
+            drain[i].cancelled = reqq_flush(&req_queue[i]);
+            drain[i].time_us = k_ticks_to_us_floor64(k_uptime_ticks() - drain_start);
+        }
+        drain[i].served = aps[i].stats.served - drain[i].served;
+        server_stop(&aps[i]);
+    }
     
-    printk("Terminating polling server\n");
+    printk("Terminating the aperiodic servers\n");
     
     printk("\nNo of request served: %d\n",total_requests);
-    average_response_time = (average_response_time) / (total_requests * 1000000); //converting nanoseconds to milliseconds
+    reqstats_summary(&rt);
+
+    printk("\nAverage response time: %llums\n", rt.sum_us / 1000 / MAX(rt.served, 1));
+    reqstats_print();
+#if REQ_CSV
+    reqstats_csv();     //for the RTT console, the shell has "requests csv"
+#endif
+    printk("Queueing: avg %llu us, max %llu us. Service: avg %llu us, max %llu us\n",
+           total_queueing_time / 1000 / MAX(total_requests, 1), max_queueing_time / 1000,
+           total_service_time / 1000 / MAX(total_requests, 1), max_service_time / 1000);
+    printk("%d past their soft deadline of %d us\n", rt.missed, REQ_DEADLINE);
+    for (int i = 0; i < NUM_SERVERS; ++i) {
+        struct aps_server *s = &aps[i];
+
+        printk("\n%s (%s): %u requests served\n", poll_info[i].t_name, server_names[s->kind], s->stats.served);
+        printk("Queue (%s): %u queued, %u dropped (full), %u rejected (admission), max depth %u\n",
+               req_order_names[REQ_ORDER], req_queue[i].stats.queued, req_queue[i].stats.dropped,
+               req_queue[i].stats.rejected, req_queue[i].stats.max_depth);
+        printk("End of run: %u queued%s; %u served in %u us of drain, %u cancelled%s\n", drain[i].queued,
+               drain[i].in_service ? " and 1 in service" : "", drain[i].served, drain[i].time_us,
+               drain[i].cancelled, drain[i].aborted ? ", server aborted with a request in service" : "");
+        if (REQ_BATCH > 0) {
+            printk("Batches of up to %d requests: %u activations, %u yielded before the budget was used\n",
+                   REQ_BATCH, s->stats.activations, s->stats.yields);
+        }
+        printk("%s server: %u replenishments, %u exhausted, %u lost, %u served in background\n",
+               server_names[s->kind], s->stats.replenishments, s->stats.exhausted, s->stats.lost,
+               s->stats.served_bg);
+        printk("Budget used per %d ms period: avg %u us, min %u us, max %u us of %d us (%u periods)\n",
+               poll_info[i].period, (uint32_t)(s->stats.used_ns / 1000 / MAX(s->stats.periods, 1)),
+               s->stats.min_period_us, s->stats.max_period_us, 1000 * poll_info[i].budget, s->stats.periods);
+        printk("Demotion latency (budget expiry to priority %d): avg %u ns, max %u ns (%u demotions)\n", BG_PRIO,
+               (uint32_t)(s->stats.demote.sum_ns / MAX(s->stats.demote.count, 1)), s->stats.demote.max_ns,
+               s->stats.demote.count);
+    }
+
+    printk("\nOverruns (cascade = misses while another task was overrunning)\n");
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        printk("%s %s: missed %u skipped %u aborted %u demoted %u degraded %u cascade %u\n",
+               threads[i].t_name, overrun_names[threads[i].overrun], ovr[i].misses, ovr[i].skipped,
+               ovr[i].aborted, ovr[i].demoted, ovr[i].degraded, ovr[i].cascade_misses);
+    }
 
-    printk("\nAverage response time: %lldms\n", average_response_time);
+#ifdef BENCH_RUN
+    //Machine readable results for bench.sh
+    printk("RESULT server kind=%s poll_prio=%d budget_ms=%d arr_time_us=%d arr_mode=%s arr_seed=%u bursts=%u "
+           "req_loop=%d served=%d generated=%d "
+           "avg_response_ms=%llu served_bg=%u exhausted=%u budget_avg_us=%u budget_max_us=%u "
+           "demote_max_ns=%u\n",
+           server_names[SERVER], POLL_PRIO, BUDGET, ARR_TIME, arr_mode_names[ARR_MODE], ARR_SEED, arr.bursts,
+           REQ_LOOP, total_requests, total_req,
+           rt.sum_us / 1000 / MAX(rt.served, 1), aps[0].stats.served_bg, aps[0].stats.exhausted,
+           (uint32_t)(aps[0].stats.used_ns / 1000 / MAX(aps[0].stats.periods, 1)), aps[0].stats.max_period_us,
+           aps[0].stats.demote.max_ns);
+    for (int i = 1; i < NUM_SERVERS; ++i) {
+        printk("RESULT server%d kind=%s prio=%d budget_ms=%d period_ms=%d weight=%d served=%u served_bg=%u "
+               "exhausted=%u budget_avg_us=%u budget_max_us=%u queued=%u dropped=%u rejected=%u end_queued=%u "
+               "drain_served=%u cancelled=%u aborted=%d\n", i,
+               server_names[aps[i].kind], poll_info[i].priority, poll_info[i].budget, poll_info[i].period,
+               poll_info[i].weight, aps[i].stats.served, aps[i].stats.served_bg, aps[i].stats.exhausted,
+               (uint32_t)(aps[i].stats.used_ns / 1000 / MAX(aps[i].stats.periods, 1)), aps[i].stats.max_period_us,
+               req_queue[i].stats.queued, req_queue[i].stats.dropped, req_queue[i].stats.rejected,
+               drain[i].queued + drain[i].in_service, drain[i].served, drain[i].cancelled, drain[i].aborted);
+    }
+    printk("RESULT requests batch=%d avg_queue_us=%llu max_queue_us=%llu avg_service_us=%llu max_service_us=%llu "
+           "activations=%u yields=%u order=%s queued=%u dropped=%u rejected=%u max_depth=%u soft_misses=%d "
+           "end_queued=%u drain_served=%u cancelled=%u drain_us=%u aborted=%d\n", REQ_BATCH, total_queueing_time / 1000 / MAX(total_requests, 1),
+           max_queueing_time / 1000, total_service_time / 1000 / MAX(total_requests, 1), max_service_time / 1000,
+           aps[0].stats.activations, aps[0].stats.yields, req_order_names[REQ_ORDER], req_queue[0].stats.queued,
+           req_queue[0].stats.dropped, req_queue[0].stats.rejected, req_queue[0].stats.max_depth, rt.missed,
+           drain[0].queued + drain[0].in_service, drain[0].served, drain[0].cancelled, drain[0].time_us,
+           drain[0].aborted);
+    printk("RESULT response min_us=%u p50_us=%u p95_us=%u p99_us=%u max_us=%u avg_us=%llu recorded=%u\n", rt.min_us,
+           rt.p50_us, rt.p95_us, rt.p99_us, rt.max_us, rt.sum_us / MAX(rt.served, 1), rt.recorded);
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        printk("RESULT %s jobs=%u missed=%u skipped=%u aborted=%u cascade=%u\n", threads[i].t_name,
+               job_count[i], ovr[i].misses, ovr[i].skipped, ovr[i].aborted, ovr[i].cascade_misses);
+    }
+    printk("BENCH_END\n");
+#ifdef CONFIG_ARCH_POSIX
+    posix_exit(0);      //native_posix: end the process, bench.sh reads its output
+#endif
+#endif
 }
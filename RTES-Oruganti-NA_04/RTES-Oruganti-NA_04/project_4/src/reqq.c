@@ -0,0 +1,210 @@
+/*
+* Aperiodic request queue, see reqq.h.
+*/
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <errno.h>
+#include <string.h>
+#define TASK_MODEL_TYPES_ONLY       // the task set variables are defined by main.c
+#include "reqq.h"
+
+const char * const req_order_names[REQ_ORDERS] = REQ_ORDER_NAMES;
+
+//true when a is served before b
+static bool before(const struct reqq *q, const struct req_type *a, const struct req_type *b)
+{
+    switch (q->order)
+    {
+    case REQ_SJF:
+        if (a->iterations != b->iterations)
+        {
+            return a->iterations < b->iterations;
+        }
+        break;
+    case REQ_EDF:
+        if (a->deadline != b->deadline)
+        {
+            return (int32_t)(a->deadline - b->deadline) < 0;
+        }
+        break;
+    default:
+        break;
+    }
+    return (int32_t)(a->id - b->id) < 0;     //arrival order
+}
+
+static void swap(struct req_type *a, struct req_type *b)
+{
+    struct req_type t = *a;
+
+    *a = *b;
+    *b = t;
+}
+
+static void heap_push(struct reqq *q, const struct req_type *req)
+{
+    int i = q->heap_len++;
+
+    q->heap[i] = *req;
+    while (i > 0 && before(q, &q->heap[i], &q->heap[(i - 1) / 2]))
+    {
+        swap(&q->heap[i], &q->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_pop(struct reqq *q, struct req_type *req)
+{
+    int i = 0;
+
+    *req = q->heap[0];
+    q->heap[0] = q->heap[--q->heap_len];
+
+    while (1)
+    {
+        int first = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+
+        if (l < q->heap_len && before(q, &q->heap[l], &q->heap[first]))
+        {
+            first = l;
+        }
+        if (r < q->heap_len && before(q, &q->heap[r], &q->heap[first]))
+        {
+            first = r;
+        }
+        if (first == i)
+        {
+            break;
+        }
+        swap(&q->heap[i], &q->heap[first]);
+        i = first;
+    }
+}
+
+/*
+* Consumer: moves the requests of the ring into the heap. A ring slot
+* is only given back to the producer (tail) after it has been copied.
+*/
+static void drain(struct reqq *q)
+{
+    atomic_val_t head = atomic_get(&q->head);
+    atomic_val_t tail = atomic_get(&q->tail);
+
+    while (tail != head)
+    {
+        heap_push(q, &q->ring[tail & (REQQ_SIZE - 1)]);
+        tail++;
+        atomic_set(&q->tail, tail);
+    }
+}
+
+void reqq_init(struct reqq *q, enum req_order order, int64_t (*cost)(const struct req_type *req))
+{
+    memset(q, 0, sizeof(*q));
+    q->order = order;
+    q->cost = cost;
+    k_sem_init(&q->count, 0, K_SEM_MAX_LIMIT);
+}
+
+/*
+* Producer, called from the request timer. The ring holds at most
+* REQQ_SIZE requests, and together with the heap no more than that are
+* ever queued, so the heap cannot overflow either.
+*/
+int reqq_put(struct reqq *q, const struct req_type *req)
+{
+    atomic_val_t head = atomic_get(&q->head);
+    uint32_t depth = reqq_num_used(q);
+    uint32_t cost_us = q->cost(req) / 1000;
+
+    if (depth >= REQQ_SIZE || head - atomic_get(&q->tail) >= REQQ_SIZE)
+    {
+        q->stats.dropped++;
+        return -ENOSPC;
+    }
+
+    if (REQ_ADMIT && k_cyc_to_us_floor64(req->deadline - req->arr_time) <
+        (uint64_t)atomic_get(&q->backlog_us) + cost_us)
+    {
+        q->stats.rejected++;
+        return -EAGAIN;
+    }
+
+    q->ring[head & (REQQ_SIZE - 1)] = *req;
+    atomic_set(&q->head, head + 1);       //publishes the slot, atomic_set is a full barrier
+    atomic_add(&q->backlog_us, cost_us);
+
+    q->stats.queued++;
+    q->stats.max_depth = MAX(q->stats.max_depth, depth + 1);
+    k_sem_give(&q->count);
+    return 0;
+}
+
+//Consumer: the request served next, without taking it
+int reqq_peek(struct reqq *q, struct req_type *req)
+{
+    drain(q);
+    if (q->heap_len == 0)
+    {
+        return -ENOMSG;
+    }
+    *req = q->heap[0];
+    return 0;
+}
+
+//Consumer: takes the request served next, waiting up to timeout for one
+int reqq_get(struct reqq *q, struct req_type *req, k_timeout_t timeout)
+{
+    if (k_sem_take(&q->count, timeout) != 0)
+    {
+        return -EAGAIN;
+    }
+    drain(q);
+    if (q->heap_len == 0)       //only the count given by reqq_close() is left
+    {
+        k_sem_give(&q->count);  //for the next call
+        return -ESHUTDOWN;
+    }
+    heap_pop(q, req);
+    atomic_sub(&q->backlog_us, q->cost(req) / 1000);
+    return 0;
+}
+
+//Requests waiting, from any context
+uint32_t reqq_num_used(struct reqq *q)
+{
+    uint32_t n = k_sem_count_get(&q->count);
+
+    return atomic_get(&q->closed) ? n - MIN(n, 1) : n;
+}
+
+/*
+* Called once the producer is stopped: a consumer waiting in reqq_get()
+* wakes up, and an empty queue no longer waits for requests.
+*/
+void reqq_close(struct reqq *q)
+{
+    atomic_set(&q->closed, 1);
+    k_sem_give(&q->count);
+}
+
+//Consumer, or any thread once the consumer is gone: cancels the requests still queued
+uint32_t reqq_flush(struct reqq *q)
+{
+    struct req_type req;
+    uint32_t n = 0;
+
+    drain(q);
+    while (q->heap_len > 0)
+    {
+        heap_pop(q, &req);
+        atomic_sub(&q->backlog_us, q->cost(&req) / 1000);
+        (void)k_sem_take(&q->count, K_NO_WAIT);
+        n++;
+    }
+    q->stats.cancelled += n;
+    return n;
+}
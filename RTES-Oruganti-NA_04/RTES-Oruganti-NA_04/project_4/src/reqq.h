@@ -0,0 +1,64 @@
+#ifndef __REQQ_H__
+#define __REQQ_H__
+
+/*
+ * Bounded aperiodic request queue.
+ *
+ * The request timer (producer, interrupt context) and the server thread
+ * (consumer) share a lock-free single-producer/single-consumer ring: the
+ * producer only writes head, the consumer only writes tail. The consumer
+ * moves the requests from the ring into a heap it owns, ordered by
+ * REQ_FIFO (arrival), REQ_SJF (fewest iterations first) or REQ_EDF
+ * (earliest soft deadline first), and serves from the heap.
+ *
+ * A request that finds the ring full is dropped. With REQ_ADMIT the
+ * producer also rejects a request whose estimated execution time, after
+ * the estimated backlog of the queue, would end past its soft deadline.
+ * A counting semaphore holds the number of queued requests, so the
+ * server can wait for one.
+ *
+ * At the end of the run, with the producer stopped, reqq_close() wakes
+ * the server; reqq_get() then returns -ESHUTDOWN once the queue is
+ * empty, and reqq_flush() cancels what the server has no time left for.
+ */
+
+#include <zephyr.h>
+#include "task_model_p4_new.h"
+
+#define REQQ_SIZE 32           // ring and heap entries, a power of two
+
+struct reqq_stats
+{
+    uint32_t queued;            // requests admitted
+    uint32_t dropped;           // ring full
+    uint32_t rejected;          // refused by the admission control
+    uint32_t max_depth;         // most requests waiting at once
+    uint32_t cancelled;         // still queued when the server stopped
+};
+
+struct reqq
+{
+    enum req_order order;
+    int64_t (*cost)(const struct req_type *req);    // estimated execution time in ns, for the admission
+    struct req_type ring[REQQ_SIZE];
+    atomic_t head;              // next slot to write, producer only
+    atomic_t tail;              // next slot to read, consumer only
+    atomic_t backlog_us;        // estimated execution time of the queued requests
+    struct req_type heap[REQQ_SIZE + 1];    // consumer only, + 1: reqq_put() may count one request already taken
+    int heap_len;
+    struct k_sem count;         // queued requests, ring and heap, + 1 once closed
+    atomic_t closed;
+    struct reqq_stats stats;
+};
+
+void reqq_init(struct reqq *q, enum req_order order, int64_t (*cost)(const struct req_type *req));
+int reqq_put(struct reqq *q, const struct req_type *req);
+int reqq_peek(struct reqq *q, struct req_type *req);
+int reqq_get(struct reqq *q, struct req_type *req, k_timeout_t timeout);
+uint32_t reqq_num_used(struct reqq *q);
+void reqq_close(struct reqq *q);
+uint32_t reqq_flush(struct reqq *q);
+
+extern const char * const req_order_names[REQ_ORDERS];
+
+#endif // __REQQ_H__
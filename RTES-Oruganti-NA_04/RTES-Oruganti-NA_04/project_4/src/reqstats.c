@@ -0,0 +1,196 @@
+/*
+* Response times of the aperiodic requests, see reqstats.h.
+*
+* The server threads add records under a spinlock, as they preempt each
+* other; the shell reads them while the run goes on, so a print may miss
+* the request being added.
+*/
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/printk.h>
+#include <sys/util.h>
+#include <shell/shell.h>
+#include <string.h>
+#define TASK_MODEL_TYPES_ONLY       // the task set variables are defined by main.c
+#include "reqstats.h"
+
+static struct req_record records[MAX_RECORD];
+static uint32_t sorted_us[MAX_RECORD];      // scratch for the percentiles
+static uint32_t hist[RT_HIST_BUCKETS];
+static struct rt_summary totals;
+static struct k_spinlock lock;             // records, hist and totals
+
+void reqstats_reset(void)
+{
+    memset(hist, 0, sizeof(hist));
+    memset(&totals, 0, sizeof(totals));
+    totals.min_us = UINT32_MAX;
+}
+
+/*
+* Time since a request arrived. The cycle difference is exact but wraps
+* after 2^32 cycles (seconds on a fast core), so past half of that the
+* 64 bit tick count of the arrival is used.
+*/
+static uint64_t since_arrival_us(const struct req_type *req, uint32_t cyc)
+{
+    uint64_t ticks = k_uptime_ticks() - req->arr_ticks;
+
+    if (k_ticks_to_cyc_floor64(ticks) < (1ULL << 31))
+    {
+        return k_cyc_to_us_floor64(sub32(req->arr_time, cyc));
+    }
+    return k_ticks_to_us_floor64(ticks);
+}
+
+static uint32_t bucket(uint32_t us)
+{
+    uint32_t k = 0;
+
+    while (us > 0 && k < RT_HIST_BUCKETS - 1)
+    {
+        us >>= 1;
+        k++;
+    }
+    return k;
+}
+
+//Called by the server when a request is done
+void reqstats_add(const struct req_type *req, uint32_t start_cyc, uint32_t end_cyc)
+{
+    uint32_t response_us = MIN(since_arrival_us(req, end_cyc), UINT32_MAX);
+    uint32_t service_us = k_cyc_to_us_floor64(sub32(start_cyc, end_cyc));
+    bool missed = (int32_t)(end_cyc - req->deadline) > 0;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (totals.recorded < MAX_RECORD)
+    {
+        struct req_record *r = &records[totals.recorded];
+
+        r->id = req->id;
+        r->cls = req->cls;
+        r->queue_us = response_us > service_us ? response_us - service_us : 0;
+        r->service_us = service_us;
+        r->response_us = response_us;
+        r->missed = missed;
+        totals.recorded++;
+    }
+
+    totals.served++;
+    totals.missed += missed;
+    totals.sum_us += response_us;
+    totals.min_us = MIN(totals.min_us, response_us);
+    totals.max_us = MAX(totals.max_us, response_us);
+    hist[bucket(response_us)]++;
+    k_spin_unlock(&lock, key);
+}
+
+//nearest rank percentile of the n sorted response times
+static uint32_t percentile(uint32_t n, uint32_t p)
+{
+    return sorted_us[(n * p + 99) / 100 - 1];
+}
+
+void reqstats_summary(struct rt_summary *sum)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    uint32_t n;
+
+    *sum = totals;
+    k_spin_unlock(&lock, key);
+    n = sum->recorded;
+    if (n == 0)
+    {
+        sum->min_us = 0;
+        return;
+    }
+
+    for (uint32_t i = 0; i < n; i++)        //insertion sort, MAX_RECORD is small
+    {
+        uint32_t v = records[i].response_us;
+        uint32_t j = i;
+
+        for (; j > 0 && sorted_us[j - 1] > v; j--)
+        {
+            sorted_us[j] = sorted_us[j - 1];
+        }
+        sorted_us[j] = v;
+    }
+
+    sum->p50_us = percentile(n, 50);
+    sum->p95_us = percentile(n, 95);
+    sum->p99_us = percentile(n, 99);
+}
+
+void reqstats_print(void)
+{
+    struct rt_summary sum;
+
+    reqstats_summary(&sum);
+    printk("Response time (us): served %u, avg %llu, min %u, p50 %u, p95 %u, p99 %u, max %u, "
+           "%u past the soft deadline (percentiles of the first %u)\n", sum.served,
+           sum.sum_us / MAX(sum.served, 1), sum.min_us, sum.p50_us, sum.p95_us, sum.p99_us, sum.max_us,
+           sum.missed, sum.recorded);
+    for (int k = 0; k < RT_HIST_BUCKETS; k++)
+    {
+        if (hist[k])
+        {
+            printk("  < %10u us: %u\n", 1U << k, hist[k]);
+        }
+    }
+}
+
+void reqstats_csv(void)
+{
+    printk("id,class,queue_us,service_us,response_us,missed\n");
+    for (uint32_t i = 0; i < totals.recorded; i++)
+    {
+        printk("%u,%u,%u,%u,%u,%d\n", records[i].id, records[i].cls, records[i].queue_us, records[i].service_us,
+               records[i].response_us, records[i].missed);
+    }
+}
+
+static int requests_stats(const struct shell *shell, size_t argc, char **argv)
+{
+    struct rt_summary sum;
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    reqstats_summary(&sum);
+    shell_print(shell, "served %u, avg %llu us, min %u us, p50 %u us, p95 %u us, p99 %u us, max %u us, "
+                "%u past the soft deadline (percentiles of the first %u)", sum.served,
+                sum.sum_us / MAX(sum.served, 1), sum.min_us, sum.p50_us, sum.p95_us, sum.p99_us, sum.max_us,
+                sum.missed, sum.recorded);
+    for (int k = 0; k < RT_HIST_BUCKETS; k++)
+    {
+        if (hist[k])
+        {
+            shell_print(shell, "< %10u us: %u", 1U << k, hist[k]);
+        }
+    }
+    return 0;
+}
+
+static int requests_csv(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    shell_print(shell, "id,class,queue_us,service_us,response_us,missed");
+    for (uint32_t i = 0; i < totals.recorded; i++)
+    {
+        shell_print(shell, "%u,%u,%u,%u,%u,%d", records[i].id, records[i].cls, records[i].queue_us, records[i].service_us,
+                    records[i].response_us, records[i].missed);
+    }
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(requests_cmds,
+    SHELL_CMD(stats, NULL, "Response time summary and histogram of the requests", requests_stats),
+    SHELL_CMD(csv, NULL, "Recorded requests as CSV", requests_csv),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(requests, &requests_cmds, "Aperiodic request statistics", NULL);
@@ -0,0 +1,49 @@
+#ifndef __REQSTATS_H__
+#define __REQSTATS_H__
+
+/*
+ * Response times of the aperiodic requests.
+ *
+ * Every served request is recorded in a preallocated buffer of MAX_RECORD
+ * entries (queueing, service and response time); requests beyond that
+ * only go into the counters and the histogram. The percentiles are taken
+ * from the recorded requests. The histogram is log-scale: bucket k holds
+ * the response times from 2^(k-1) to 2^k - 1 us, bucket 0 those under 1 us.
+ *
+ * "requests stats" and "requests csv" on the shell print the summary and
+ * the records; reqstats_print() and reqstats_csv() do the same with printk,
+ * for the RTT console.
+ */
+
+#include <zephyr.h>
+#include "task_model_p4_new.h"
+
+#define RT_HIST_BUCKETS 28      // up to 2^27 us, longer responses go into the last bucket
+
+struct req_record
+{
+    uint32_t id;
+    uint8_t cls;                // request class, the server that served it
+    uint32_t queue_us;          // arrival to start of service
+    uint32_t service_us;        // start to end of service
+    uint32_t response_us;       // arrival to end of service
+    bool missed;                // ended after the soft deadline
+};
+
+struct rt_summary
+{
+    uint32_t served;            // requests served
+    uint32_t recorded;          // of them in the record buffer
+    uint32_t missed;            // ended after the soft deadline
+    uint64_t sum_us;
+    uint32_t min_us, max_us;
+    uint32_t p50_us, p95_us, p99_us;    // of the recorded requests
+};
+
+void reqstats_reset(void);
+void reqstats_add(const struct req_type *req, uint32_t start_cyc, uint32_t end_cyc);
+void reqstats_summary(struct rt_summary *sum);
+void reqstats_print(void);
+void reqstats_csv(void);
+
+#endif // __REQSTATS_H__
@@ -0,0 +1,678 @@
+/*
+* Aperiodic servers, see server.h.
+*
+* Every function that changes the budget state runs with the server lock
+* held: the budget and replenishment timers, the switch hooks and the
+* server thread all share it. Priority changes are only requested under
+* the lock and made by prio_apply() once it is released: by the server
+* thread itself, or for the timers by prio_thread, since
+* k_thread_priority_set() may not be called from an interrupt.
+*/
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/util.h>
+#include <string.h>
+#define TASK_MODEL_TYPES_ONLY       // the task set variables are defined by main.c
+#include "server.h"
+#include "reqq.h"
+#include "slack.h"
+
+const char * const server_names[SERVER_KINDS] = SERVER_NAMES;
+
+static struct aps_server *servers[MAX_SERVERS];     // servers set up by server_init()
+static int num_servers;
+static K_SEM_DEFINE(prio_sem, 0, 1);                // priority changes requested by a timer
+
+static int64_t full_budget(struct aps_server *s)
+{
+    return (int64_t)1000000 * s->info->budget;
+}
+
+//requests a priority change, made by prio_apply() after the lock is released
+static void set_prio(struct aps_server *s, int prio)
+{
+    s->prio = prio;
+    s->prio_seq++;
+}
+
+static void latency_add(struct server_latency *l, uint32_t start_cyc)
+{
+    uint32_t ns = k_cyc_to_ns_floor64(sub32(start_cyc, k_cycle_get_32()));
+
+    l->count++;
+    l->sum_ns += ns;
+    l->max_ns = MAX(l->max_ns, ns);
+}
+
+/*
+* Sets the priority requested last. Requests are numbered: if one comes
+* in while an older one is being set (a timer interrupts the thread),
+* the loop sets the newer one again, so the last request always wins and
+* none is lost.
+*/
+static void prio_apply(struct aps_server *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+    uint32_t seq;
+    int prio;
+
+    while (s->applied_seq != s->prio_seq)
+    {
+        seq = s->prio_seq;
+        prio = s->prio;
+        k_spin_unlock(&s->lock, key);
+
+        k_thread_priority_set(s->info->poll_tid, prio);   //may switch to another thread in thread context
+
+        key = k_spin_lock(&s->lock);
+        if (s->prio_seq == seq)
+        {
+            s->applied_seq = seq;
+        }
+        if (prio == BG_PRIO && s->demote_pending)
+        {
+            s->demote_pending = false;
+            latency_add(&s->stats.demote, s->exhaust_cyc);
+        }
+    }
+    k_spin_unlock(&s->lock, key);
+}
+
+/*
+* Applies the priority changes of the timers. The highest cooperative
+* priority makes it run right at the end of the timer interrupt, before
+* any other thread and without waiting behind system workqueue items.
+*/
+static void prio_thread(void *unused1, void *unused2, void *unused3)
+{
+    while (1)
+    {
+        k_sem_take(&prio_sem, K_FOREVER);
+        for (int i = 0; i < num_servers; i++)
+        {
+            prio_apply(servers[i]);
+        }
+    }
+}
+
+K_THREAD_DEFINE(prio_tid, 1024, prio_thread, NULL, NULL, NULL, K_HIGHEST_THREAD_PRIO, 0, 0);
+
+/*
+* Starts charging the budget if the server thread is the running
+* thread and has budget left. Service in the background is free. The timer only enforces the budget, with
+* tick resolution; what is charged is measured in cycles.
+*/
+static void budget_start(struct aps_server *s)
+{
+    if (s->charging || s->info->left_budget <= 0 || s->prio == BG_PRIO || k_current_get() != s->info->poll_tid)
+    {
+        return;
+    }
+
+    s->charging = true;
+    s->charge_start = k_uptime_ticks();
+    s->info->last_switched_in = k_cycle_get_32();
+    k_timer_start(&s->budget_timer, K_NSEC(s->info->left_budget), K_NO_WAIT);
+}
+
+/*
+* Budget use per period of the server, counted in windows of
+* info->period from server_init(). Windows without any use count as
+* periods with none.
+*/
+static void period_close(struct aps_server *s)
+{
+    uint32_t used_us = s->window_used_ns / 1000;
+
+    s->stats.periods++;
+    s->stats.max_period_us = MAX(s->stats.max_period_us, used_us);
+    s->stats.min_period_us = MIN(s->stats.min_period_us, used_us);
+    s->window_used_ns = 0;
+}
+
+static void charge(struct aps_server *s, int64_t used_ns)
+{
+    int64_t window = (k_uptime_ticks() - s->start_ticks) / k_ms_to_ticks_ceil64(s->info->period);
+
+    if (window != s->window)
+    {
+        period_close(s);
+        if (window > s->window + 1)
+        {
+            s->stats.periods += window - s->window - 1;
+            s->stats.min_period_us = 0;
+        }
+        s->window = window;
+    }
+    s->window_used_ns += used_ns;
+    s->stats.used_ns += used_ns;
+
+    if (s->ops->consumed)
+    {
+        s->ops->consumed(s, s->charge_start, used_ns);
+    }
+}
+
+/*
+* Stops charging the budget and takes the cycles run since the switch
+* in off left_budget.
+*/
+static void budget_stop(struct aps_server *s)
+{
+    int64_t used;
+
+    if (!s->charging)
+    {
+        return;
+    }
+
+    k_timer_stop(&s->budget_timer);
+    s->charging = false;
+
+    used = k_cyc_to_ns_floor64(sub32(s->info->last_switched_in, k_cycle_get_32()));
+    used = MIN(used, s->info->left_budget);
+    s->info->left_budget -= used;
+    charge(s, used);
+}
+
+/*
+* Sets the budget to budget_ns and restores the server priority.
+*/
+static void budget_give(struct aps_server *s, int64_t budget_ns)
+{
+    budget_stop(s);
+    s->info->left_budget = budget_ns;
+    s->stats.replenishments++;
+    s->batch_left = -1;     //a new activation
+    evtrace_log(EVT_BUDGET_REPLENISH, s->trace_id, (uint32_t)(budget_ns / 1000));
+    set_prio(s, s->info->priority);
+    budget_start(s);        //the server may be the interrupted thread
+}
+
+//budget left now, including the time run since the switch in
+static int64_t budget_left(struct aps_server *s)
+{
+    int64_t left = s->info->left_budget;
+
+    if (s->charging)
+    {
+        left -= k_cyc_to_ns_floor64(sub32(s->info->last_switched_in, k_cycle_get_32()));
+    }
+    return MAX(left, 0);
+}
+
+//Budget timer expiry: the server goes to background mode
+static void budget_expiry_function(struct k_timer *timer_exp)
+{
+    struct aps_server *s = timer_exp->user_data;
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    if (s->charging)
+    {
+        int64_t used = s->info->left_budget;
+
+        s->charging = false;
+        s->info->left_budget = 0;
+        charge(s, used);
+        s->stats.exhausted++;
+        s->exhaust_cyc = k_cycle_get_32();
+        s->demote_pending = true;
+        evtrace_log(EVT_BUDGET_EXHAUSTED, s->trace_id, 0);
+        if (s->ops->suspend)
+        {
+            s->ops->suspend(s, false);
+        }
+        set_prio(s, BG_PRIO);
+    }
+
+    k_spin_unlock(&s->lock, key);
+    k_sem_give(&prio_sem);
+}
+
+static void repl_expiry_function(struct k_timer *timer_exp)
+{
+    struct aps_server *s = timer_exp->user_data;
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    s->ops->replenish(s);
+    k_spin_unlock(&s->lock, key);
+    k_sem_give(&prio_sem);
+}
+
+/*
+* Polling server.
+*
+* The budget is only kept while there is work: at the replenishment the
+* server polls the queue, and when it runs out of requests the rest of
+* the budget is dropped until the next period.
+*/
+static void polling_replenish(struct aps_server *s)
+{
+    if (!s->busy && reqq_num_used(s->queue) == 0)
+    {
+        s->info->left_budget = 0;
+        s->stats.lost++;
+        return;
+    }
+    budget_give(s, full_budget(s));
+}
+
+static void polling_suspend(struct aps_server *s, bool idle)
+{
+    if (idle)
+    {
+        if (s->info->left_budget > 0)
+        {
+            s->info->left_budget = 0;
+            s->stats.lost++;
+        }
+        set_prio(s, BG_PRIO);
+    }
+}
+
+/*
+* Deferrable server.
+*
+* Same replenishment as the polling server, but the budget is kept
+* while the server waits for requests.
+*/
+static void deferrable_replenish(struct aps_server *s)
+{
+    budget_give(s, full_budget(s));
+}
+
+/*
+* Sporadic server.
+*
+* The server becomes active at the first switch in with budget. The
+* budget used until it is exhausted or idle again is given back one
+* period after the activation. Pending replenishments are a FIFO, their
+* times only grow.
+*/
+static void sporadic_arm(struct aps_server *s)
+{
+    int64_t delay = s->ss_repl[s->ss_head].at_ticks - k_uptime_ticks();
+
+    k_timer_start(&s->repl_timer, K_TICKS(MAX(delay, 0)), K_NO_WAIT);
+}
+
+static void sporadic_consumed(struct aps_server *s, int64_t start_ticks, int64_t used_ns)
+{
+    if (!s->ss_active)
+    {
+        s->ss_active = true;
+        s->ss_start = start_ticks;
+        s->ss_used_ns = 0;
+    }
+    s->ss_used_ns += used_ns;
+}
+
+static void sporadic_suspend(struct aps_server *s, bool idle)
+{
+    struct sporadic_repl *r;
+
+    if (!s->ss_active)
+    {
+        return;
+    }
+    s->ss_active = false;
+
+    if (s->ss_used_ns == 0)
+    {
+        return;
+    }
+
+    if (s->ss_count == SS_MAX_REPL)     //merge into the last one, later is safe
+    {
+        r = &s->ss_repl[(s->ss_head + s->ss_count - 1) % SS_MAX_REPL];
+        r->at_ticks = s->ss_start + k_ms_to_ticks_ceil64(s->info->period);
+        r->amount_ns += s->ss_used_ns;
+        return;
+    }
+
+    r = &s->ss_repl[(s->ss_head + s->ss_count) % SS_MAX_REPL];
+    r->at_ticks = s->ss_start + k_ms_to_ticks_ceil64(s->info->period);
+    r->amount_ns = s->ss_used_ns;
+    if (s->ss_count++ == 0)
+    {
+        sporadic_arm(s);
+    }
+}
+
+static void sporadic_replenish(struct aps_server *s)
+{
+    struct sporadic_repl *r = &s->ss_repl[s->ss_head];
+    int64_t amount = r->amount_ns;
+
+    s->ss_head = (s->ss_head + 1) % SS_MAX_REPL;
+    s->ss_count--;
+
+    budget_stop(s);     //the used part of the budget is already in ss_used_ns
+    budget_give(s, MIN(s->info->left_budget + amount, full_budget(s)));
+
+    if (s->ss_count > 0)
+    {
+        sporadic_arm(s);
+    }
+}
+
+/*
+* Total bandwidth server.
+*
+* The budget of a request is its estimated execution time. It can be
+* used from max(arrival, previous deadline); before that the request is
+* served in the background. Between requests the server waits at its
+* priority without budget, so the next request is picked up at once and
+* gets its budget and deadline on arrival at the server.
+*/
+static void tbs_request(struct aps_server *s, const struct req_type *req, int64_t cost_ns)
+{
+    int64_t now = k_uptime_ticks();
+    int64_t arrival = now - k_cyc_to_ticks_floor64(k_cycle_get_32() - req->arr_time);
+    int64_t start = MAX(arrival, s->tbs_deadline);
+
+    s->tbs_deadline = start + k_ns_to_ticks_ceil64(cost_ns * s->info->period / s->info->budget);
+
+    budget_stop(s);
+    s->info->left_budget = 0;
+    if (start <= now)
+    {
+        budget_give(s, cost_ns);
+    }
+    else
+    {
+        s->tbs_cost_ns = cost_ns;
+        k_timer_start(&s->repl_timer, K_TICKS(start - now), K_NO_WAIT);
+        set_prio(s, BG_PRIO);
+    }
+}
+
+static void tbs_replenish(struct aps_server *s)
+{
+    budget_give(s, s->tbs_cost_ns);
+    s->tbs_cost_ns = 0;
+}
+
+static void tbs_suspend(struct aps_server *s, bool idle)
+{
+    if (idle)
+    {
+        k_timer_stop(&s->repl_timer);   //the budget of a request already served
+        s->tbs_cost_ns = 0;
+        s->info->left_budget = 0;
+        set_prio(s, s->info->priority);
+    }
+}
+
+/*
+* Slack stealing server.
+*
+* Every request gets the slack available at its start as budget, one
+* tick less since the budget timer can end up to a tick late. The server
+* waits for requests at SLACK_PRIO, so it gets to them at once.
+*/
+static void slack_grant(struct aps_server *s)
+{
+    int64_t slack = slack_available_ns() - k_ticks_to_ns_ceil64(1);
+
+    budget_stop(s);
+    if (slack > 0)
+    {
+        budget_give(s, slack);
+    }
+    else
+    {
+        s->info->left_budget = 0;
+        set_prio(s, BG_PRIO);
+    }
+}
+
+static void slack_request(struct aps_server *s, const struct req_type *req, int64_t cost_ns)
+{
+    slack_grant(s);
+}
+
+static void slack_suspend(struct aps_server *s, bool idle)
+{
+    if (idle)
+    {
+        s->info->left_budget = 0;       //recomputed for the next request
+        set_prio(s, s->info->priority);
+    }
+}
+
+static const struct server_ops server_ops[SERVER_KINDS] =
+{
+    [SERVER_POLLING] = { .replenish = polling_replenish, .suspend = polling_suspend },
+    [SERVER_DEFERRABLE] = { .replenish = deferrable_replenish },
+    [SERVER_SPORADIC] = { .replenish = sporadic_replenish, .consumed = sporadic_consumed,
+                          .suspend = sporadic_suspend },
+    [SERVER_TBS] = { .replenish = tbs_replenish, .suspend = tbs_suspend, .request = tbs_request },
+    [SERVER_SLACK] = { .suspend = slack_suspend, .request = slack_request },
+};
+
+/*
+* Sets up the server for the thread info->poll_tid, which must be created
+* with a start delay and not be running yet, and starts the
+* periodic replenishment of the polling and deferrable servers.
+* The TBS server starts without budget, the slack server without budget
+* at SLACK_PRIO.
+*/
+void server_init(struct aps_server *s, enum server_kind kind, struct task_aps *info,
+                 struct reqq *queue, int64_t (*cost)(const struct req_type *req), uint8_t trace_id)
+{
+    memset(s, 0, sizeof(*s));
+    s->kind = kind;
+    s->ops = &server_ops[kind];
+    s->info = info;
+    s->queue = queue;
+    s->cost = cost;
+    s->trace_id = trace_id;
+    s->batch_left = -1;
+
+    k_timer_init(&s->budget_timer, budget_expiry_function, NULL);
+    s->budget_timer.user_data = s;
+    k_timer_init(&s->repl_timer, repl_expiry_function, NULL);
+    s->repl_timer.user_data = s;
+    s->start_ticks = k_uptime_ticks();
+    s->stats.min_period_us = UINT32_MAX;
+
+    if (kind == SERVER_SLACK)
+    {
+        info->priority = SLACK_PRIO;
+    }
+    if (kind == SERVER_TBS || kind == SERVER_SLACK)
+    {
+        info->left_budget = 0;
+        s->prio = info->priority;
+    }
+    else
+    {
+        info->left_budget = full_budget(s);
+        s->prio = info->priority;
+    }
+    s->prio_seq = 1;
+    prio_apply(s);
+
+    if (num_servers < MAX_SERVERS)
+    {
+        servers[num_servers++] = s;
+    }
+
+    //the switch hooks find the server of a thread from its custom data; the thread has not run yet
+    info->poll_tid->custom_data = s;
+
+    if (kind == SERVER_POLLING || kind == SERVER_DEFERRABLE)
+    {
+        k_timer_start(&s->repl_timer, K_MSEC(info->period), K_MSEC(info->period));
+    }
+}
+
+void server_stop(struct aps_server *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    k_timer_stop(&s->budget_timer);
+    k_timer_stop(&s->repl_timer);
+    s->charging = false;
+    charge(s, 0);           //closes the windows up to now
+    period_close(s);
+    k_spin_unlock(&s->lock, key);
+}
+
+/*
+* Switch hooks, called for the server thread only.
+*/
+void server_switched_in(struct aps_server *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    budget_start(s);
+    k_spin_unlock(&s->lock, key);
+}
+
+void server_switched_out(struct aps_server *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    budget_stop(s);
+    k_spin_unlock(&s->lock, key);
+}
+
+/*
+* Batch service (REQ_BATCH > 0, not for TBS where every request has its
+* own budget). An activation starts with budget, at a replenishment or
+* when the server wakes up; it serves at most REQ_BATCH of the requests
+* queued at its start. Before each request the server predicts from its
+* estimated execution time whether it fits in the rest of the budget.
+* When the batch is done or the request does not fit, the server yields:
+* it keeps its budget but goes to BG_PRIO until the next replenishment,
+* or until a request that fits comes up within the batch.
+*/
+static void batch_check(struct aps_server *s, const struct req_type *req, uint32_t queued)
+{
+    int64_t cost = s->cost(req);
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+    bool fits = cost <= budget_left(s);
+
+    if (s->batch_left < 0 && s->info->left_budget > 0)
+    {
+        s->batch_left = MIN(REQ_BATCH, queued);
+        s->stats.activations++;
+    }
+
+    if (s->prio != BG_PRIO && (s->batch_left <= 0 || !fits))
+    {
+        budget_stop(s);
+        if (s->ops->suspend)
+        {
+            s->ops->suspend(s, false);
+        }
+        set_prio(s, BG_PRIO);
+        s->stats.yields++;
+    }
+    else if (s->prio == BG_PRIO && s->batch_left > 0 && fits)
+    {
+        set_prio(s, s->info->priority);
+    }
+
+    if (s->prio != BG_PRIO)
+    {
+        s->batch_left--;
+    }
+    k_spin_unlock(&s->lock, key);
+    prio_apply(s);
+}
+
+/*
+* Reads the next request. When the queue is empty the server suspends:
+* the polling server drops its budget, the sporadic server schedules
+* the replenishment of what it used and the TBS server waits at its
+* priority without budget.
+*/
+int server_next(struct aps_server *s, struct req_type *req, k_timeout_t timeout)
+{
+    bool batch = REQ_BATCH > 0 && s->kind != SERVER_TBS && s->kind != SERVER_SLACK;
+    k_spinlock_key_t key;
+    int ret;
+
+    if (reqq_peek(s->queue, req) == 0)
+    {
+        if (batch)
+        {
+            batch_check(s, req, reqq_num_used(s->queue));
+        }
+        return reqq_get(s->queue, req, K_NO_WAIT);     //the peeked request, the server is the only reader
+    }
+
+    key = k_spin_lock(&s->lock);
+    budget_stop(s);
+    if (s->ops->suspend)
+    {
+        s->ops->suspend(s, true);
+    }
+    s->batch_left = -1;
+    k_spin_unlock(&s->lock, key);
+    prio_apply(s);
+
+    ret = reqq_get(s->queue, req, timeout);
+    if (ret == 0 && batch)
+    {
+        batch_check(s, req, reqq_num_used(s->queue) + 1);
+    }
+    return ret;
+}
+
+void server_begin(struct aps_server *s, const struct req_type *req)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    s->busy = true;
+    if (s->ops->request)
+    {
+        s->ops->request(s, req, s->cost(req));
+    }
+    k_spin_unlock(&s->lock, key);
+    prio_apply(s);
+}
+
+void server_end(struct aps_server *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+    s->busy = false;
+    s->stats.served++;
+    if (s->prio == BG_PRIO)
+    {
+        s->stats.served_bg++;
+    }
+    k_spin_unlock(&s->lock, key);
+}
+
+/*
+* Called by a periodic task when one of its jobs ends: the slack of its
+* level grows to that of the next job, so a slack server left in the
+* background with requests may get budget again.
+*/
+void server_slack_check(void)
+{
+    for (int i = 0; i < num_servers; i++)
+    {
+        struct aps_server *s = servers[i];
+        k_spinlock_key_t key;
+
+        if (s->kind != SERVER_SLACK)
+        {
+            continue;
+        }
+
+        key = k_spin_lock(&s->lock);
+        if (s->prio == BG_PRIO && (s->busy || reqq_num_used(s->queue) > 0))
+        {
+            slack_grant(s);
+        }
+        k_spin_unlock(&s->lock, key);
+        prio_apply(s);
+    }
+}
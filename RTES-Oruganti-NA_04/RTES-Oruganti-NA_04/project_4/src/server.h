@@ -0,0 +1,144 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+/*
+ * Aperiodic servers behind one interface.
+ *
+ * All servers share the budget accounting: the budget is charged in cycles
+ * from switch in to switch out while the server thread runs with budget
+ * left, a timer for the rest of the budget enforces it, and the server drops
+ * to BG_PRIO when it is used up. The algorithms only differ in when budget is given back:
+ *
+ * SERVER_POLLING	full budget every period, lost when the queue is empty
+ *			at the replenishment or when the server runs out of work.
+ * SERVER_DEFERRABLE	full budget every period, kept while the server idles.
+ * SERVER_SPORADIC	budget used from the moment the server became active
+ *			is given back one period after that moment.
+ * SERVER_TBS		total bandwidth server. Request k gets a budget of its
+ *			estimated execution time C_k, usable from
+ *			max(arrival, d_k-1), and d_k = max(arrival, d_k-1) +
+ *			C_k * period / budget. The periodic tasks are fixed
+ *			priority, so the deadline is not used for EDF but as
+ *			the earliest start of the next budget, which keeps the
+ *			server at the bandwidth budget/period. Between
+ *			requests it waits at its priority without budget.
+ * SERVER_SLACK		slack stealing. The budget of a request is the slack
+ *			of the periodic tasks at its start (slack.h), used at
+ *			SLACK_PRIO above all tasks; without slack the request
+ *			is served in the background until a periodic job ends
+ *			and frees more. BUDGET and the period are not used.
+ *
+ * Every server is an independent object with its own thread, queue,
+ * timers and budget. server_init() stores the server in the custom data
+ * of its thread (CONFIG_THREAD_CUSTOM_DATA), so the context switch hooks
+ * get the server of the thread switched in or out without a search.
+ *
+ * The server thread reads its requests with server_next() and brackets the
+ * service of each with server_begin() and server_end(). With REQ_BATCH,
+ * server_next() serves requests in batches per activation, see server.c.
+ * server_next() returns -ESHUTDOWN once the queue is closed and empty.
+ */
+
+#include <zephyr.h>
+#include "task_model_p4_new.h"
+
+#define SS_MAX_REPL 8          // pending sporadic replenishments
+#define MAX_SERVERS 4          // servers whose timers can change their priority
+
+struct aps_server;
+struct reqq;
+
+struct server_ops
+{
+    // replenishment timer expired, interrupts locked
+    void (*replenish)(struct aps_server *s);
+    // the server ran with budget from start_ticks and used used_ns of it, interrupts locked
+    void (*consumed)(struct aps_server *s, int64_t start_ticks, int64_t used_ns);
+    // the budget is used up or the server ran out of requests, interrupts locked
+    void (*suspend)(struct aps_server *s, bool idle);
+    // a request is about to be served, cost_ns is its estimated execution time, interrupts locked
+    void (*request)(struct aps_server *s, const struct req_type *req, int64_t cost_ns);
+};
+
+struct server_latency
+{
+    uint32_t count;
+    uint64_t sum_ns;
+    uint32_t max_ns;
+};
+
+struct server_stats
+{
+    uint32_t replenishments;    // budget given back
+    uint32_t exhausted;         // budget used up while serving
+    uint32_t lost;              // replenishments or budgets dropped by the polling server
+    uint32_t served;            // requests finished
+    uint32_t served_bg;         // of them at BG_PRIO
+    uint32_t activations;       // batches started (REQ_BATCH)
+    uint32_t yields;            // batches ended before the budget (REQ_BATCH)
+    uint64_t used_ns;           // budget used in the whole run
+    uint32_t periods;           // server periods of the run
+    uint32_t max_period_us;     // most budget used in one period
+    uint32_t min_period_us;     // least budget used in one period
+    struct server_latency demote;   // budget expiry to the priority set to BG_PRIO
+};
+
+struct sporadic_repl
+{
+    int64_t at_ticks;           // uptime of the replenishment
+    int64_t amount_ns;
+};
+
+struct aps_server
+{
+    enum server_kind kind;
+    const struct server_ops *ops;
+    struct task_aps *info;      // priority, period, budget and thread; left_budget is the budget in ns
+    struct reqq *queue;
+    int64_t (*cost)(const struct req_type *req);    // estimated execution time of a request in ns
+    uint8_t trace_id;           // thread id of the server in the event trace
+    struct k_spinlock lock;     // budget state, shared with the timers and the switch hooks
+
+    bool busy;                  // a request is being served
+    int batch_left;             // requests the activation may still serve, -1 before it starts
+    bool charging;              // the budget timer runs
+    int64_t charge_start;       // uptime in ticks of the switch in that started the budget timer
+    int64_t start_ticks;        // uptime at server_init(), the periods of the statistics start here
+    int64_t window;             // current period of the statistics
+    int64_t window_used_ns;     // budget used in it
+    struct k_timer budget_timer;    // rest of the budget while the server runs
+    struct k_timer repl_timer;
+
+    int prio;                   // priority requested last, info->priority or BG_PRIO
+    uint32_t prio_seq;          // priority changes requested
+    uint32_t applied_seq;       // last of them set by prio_apply()
+    uint32_t exhaust_cyc;       // cycle count of the last budget expiry
+    bool demote_pending;        // expiry without the demotion set yet
+
+    // SERVER_SPORADIC
+    bool ss_active;             // budget is being consumed since ss_start
+    int64_t ss_start;
+    int64_t ss_used_ns;
+    struct sporadic_repl ss_repl[SS_MAX_REPL];
+    int ss_head, ss_count;
+
+    // SERVER_TBS
+    int64_t tbs_deadline;       // deadline of the last request, uptime in ticks
+    int64_t tbs_cost_ns;        // budget of the request waiting for its start
+
+    struct server_stats stats;
+};
+
+void server_init(struct aps_server *s, enum server_kind kind, struct task_aps *info,
+                 struct reqq *queue, int64_t (*cost)(const struct req_type *req), uint8_t trace_id);
+void server_switched_in(struct aps_server *s);
+void server_switched_out(struct aps_server *s);
+void server_stop(struct aps_server *s);
+int server_next(struct aps_server *s, struct req_type *req, k_timeout_t timeout);
+void server_begin(struct aps_server *s, const struct req_type *req);
+void server_end(struct aps_server *s);
+void server_slack_check(void);
+
+extern const char * const server_names[SERVER_KINDS];
+
+#endif // __SERVER_H__
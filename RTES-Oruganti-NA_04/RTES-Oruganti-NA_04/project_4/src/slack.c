@@ -0,0 +1,210 @@
+/*
+* Static slack stealing, see slack.h.
+*
+* The table is built once before the tasks start. At run time the tasks
+* only count their finished jobs, and the slack server reads the table
+* and the runtime statistics of the task threads.
+*/
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/util.h>
+#define TASK_MODEL_TYPES_ONLY       // the task set variables are defined by main.c
+#include "slack.h"
+
+struct slack_level
+{
+    k_tid_t tid;
+    uint32_t period_us;
+    uint32_t exec_us;           // with the margin
+    uint32_t jobs;              // jobs in the hyperperiod
+    int32_t *idle;              // level idle time before the deadline of each job
+    atomic_t done;              // jobs finished
+};
+
+static int32_t table[SLACK_TABLE_MAX];
+static struct slack_level levels[NUM_THREADS];     // highest priority first
+static int level_of[NUM_THREADS];                  // level of every task
+static int num_levels;
+static int64_t origin;
+static struct slack_info info;
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+* Fixed priority schedule of the levels from 0 to the hyperperiod, from
+* release to release or completion. At the deadline of a job, the
+* release of the next one, the idle time of its level so far goes into
+* the table; a job still unfinished there is a miss and its rest is
+* taken off, so the level has no slack.
+*/
+static void simulate(void)
+{
+    uint64_t next_rel[NUM_THREADS] = {0};
+    uint64_t rem[NUM_THREADS] = {0};
+    uint64_t idle[NUM_THREADS] = {0};
+    uint32_t job[NUM_THREADS] = {0};
+    uint64_t t = 0;
+
+    for (;;)
+    {
+        uint64_t next = info.hyper_us;
+        int run;
+
+        for (int k = 0; k < num_levels; k++)
+        {
+            struct slack_level *l = &levels[k];
+
+            if (next_rel[k] == t)
+            {
+                if (job[k] > 0)
+                {
+                    l->idle[job[k] - 1] = (int32_t)idle[k] - (int32_t)rem[k];
+                    info.misses += rem[k] > 0;
+                }
+                rem[k] += l->exec_us;
+                next_rel[k] += l->period_us;
+                job[k]++;
+            }
+            next = MIN(next, next_rel[k]);
+        }
+        if (t >= info.hyper_us)
+        {
+            break;
+        }
+
+        for (run = 0; run < num_levels && rem[run] == 0; run++)
+        {
+        }
+        if (run < num_levels)
+        {
+            next = MIN(next, t + rem[run]);
+            rem[run] -= next - t;
+        }
+        for (int k = 0; k < run; k++)     //idle for every level of higher priority than the one running
+        {
+            idle[k] += next - t;
+        }
+        t = next;
+    }
+
+    for (int k = 0; k < num_levels; k++)
+    {
+        info.idle_us[k] = idle[k];
+    }
+}
+
+/*
+* Builds the table for the tasks, exec_us is the execution time of a job
+* of each task. Called before the tasks start.
+*/
+int slack_init(const struct task_s *tasks, const k_tid_t *tids, const uint32_t *exec_us, int num)
+{
+    int order[NUM_THREADS];
+    uint64_t used = 0;
+
+    memset(&info, 0, sizeof(info));
+    num_levels = MIN(num, NUM_THREADS);
+    info.hyper_us = 1;
+
+    for (int i = 0; i < num_levels; i++)        //tasks by priority, the smaller number first
+    {
+        int k = i;
+
+        for (; k > 0 && tasks[order[k - 1]].priority > tasks[i].priority; k--)
+        {
+            order[k] = order[k - 1];
+        }
+        order[k] = i;
+    }
+
+    for (int k = 0; k < num_levels; k++)
+    {
+        struct slack_level *l = &levels[k];
+        int i = order[k];
+
+        level_of[i] = k;
+        l->tid = tids[i];
+        l->period_us = 1000 * tasks[i].period;
+        l->exec_us = (uint64_t)exec_us[i] * (100 + SLACK_MARGIN) / 100;
+        atomic_set(&l->done, 0);
+        info.hyper_us = info.hyper_us / gcd64(info.hyper_us, l->period_us) * l->period_us;
+    }
+
+    for (int k = 0; k < num_levels; k++)
+    {
+        levels[k].jobs = info.hyper_us / levels[k].period_us;
+        levels[k].idle = &table[used];
+        used += levels[k].jobs;
+        if (used > SLACK_TABLE_MAX)
+        {
+            num_levels = 0;     //no slack at all
+            return -ENOMEM;
+        }
+    }
+    info.jobs = used;
+
+    simulate();
+    return 0;
+}
+
+//Uptime in ticks of the first release of all tasks
+void slack_start(int64_t origin_ticks)
+{
+    origin = origin_ticks;
+}
+
+//Called by a task when one of its jobs ends, or is given up
+void slack_job_end(int task)
+{
+    atomic_inc(&levels[level_of[task]].done);
+}
+
+/*
+* Slack available now, 0 without a table or after a miss in the
+* simulated schedule. The time since the origin is rounded up and the
+* execution times down, so both err on the side of less slack.
+*/
+int64_t slack_available_ns(void)
+{
+    int64_t ticks = k_uptime_ticks() + 1 - origin;     //since the origin, rounded up
+    int64_t t = ticks >= 0 ? (int64_t)k_ticks_to_us_ceil64(ticks) : -(int64_t)k_ticks_to_us_floor64(-ticks);
+    int64_t exec = 0;
+    int64_t slack = INT64_MAX;
+
+    if (num_levels == 0 || info.misses > 0)
+    {
+        return 0;
+    }
+
+    for (int k = 0; k < num_levels; k++)
+    {
+        struct slack_level *l = &levels[k];
+        uint32_t j = atomic_get(&l->done);
+        k_thread_runtime_stats_t rt;
+        int64_t idle;
+
+        k_thread_runtime_stats_get(l->tid, &rt);
+        exec += k_cyc_to_us_floor64(rt.execution_cycles);
+        idle = (int64_t)(j / l->jobs) * info.idle_us[k] + l->idle[j % l->jobs];
+        slack = MIN(slack, idle - (t - exec));
+    }
+    return MAX(slack, 0) * 1000;
+}
+
+void slack_info(struct slack_info *out)
+{
+    *out = info;
+}
@@ -0,0 +1,48 @@
+#ifndef __SLACK_H__
+#define __SLACK_H__
+
+/*
+ * Static slack stealing for the periodic tasks in threads[].
+ *
+ * slack_init() simulates the fixed priority schedule of the tasks over
+ * their hyperperiod, all released together at the origin given to
+ * slack_start() and running for their execution time plus SLACK_MARGIN
+ * percent, and stores for every job j of every priority level k the
+ * level-k idle time before the deadline of the job: A[k][j], the time in
+ * which nothing of priority k or higher runs.
+ *
+ * Work above the priority of all tasks can take the place of that idle
+ * time without any job missing its deadline. At time t the slack of
+ * level k is A[k][j] - (t - E_k(t)): j is the oldest unfinished job of
+ * the level-k task, E_k(t) the time the tasks of level k and higher have
+ * executed (kernel thread runtime statistics), so t - E_k(t) is the
+ * level-k idle time already gone plus the slack already used. The slack
+ * available is the minimum over the levels: one table lookup per level.
+ *
+ * Only work above all tasks is covered: a single slack stealing server,
+ * and no other server at a priority between the tasks.
+ */
+
+#include <zephyr.h>
+#include "task_model_p4_new.h"
+
+#ifndef SLACK_TABLE_MAX
+#define SLACK_TABLE_MAX 4096    // jobs in a hyperperiod, all tasks together
+#endif
+#define SLACK_MARGIN 10         // percent added to the execution time of the jobs in the table
+
+struct slack_info
+{
+    uint64_t hyper_us;          // hyperperiod
+    uint32_t jobs;              // jobs in the table
+    uint32_t misses;            // deadline misses in the simulated schedule, no slack when > 0
+    uint64_t idle_us[NUM_THREADS];  // idle time per hyperperiod of every level, highest priority first
+};
+
+int slack_init(const struct task_s *tasks, const k_tid_t *tids, const uint32_t *exec_us, int num);
+void slack_start(int64_t origin_ticks);
+void slack_job_end(int task);
+int64_t slack_available_ns(void);
+void slack_info(struct slack_info *info);
+
+#endif // __SLACK_H__
@@ -13,15 +13,54 @@
  	#define DPRINTK(fmt, args...) // do nothing if not defined
 #endif
 
+#include "workload.h"
+#include "evtrace.h"
+
 #define compiler_barrier() do { \
 	__asm__ __volatile__ ("" ::: "memory"); \
 } while (false)
 
+#ifndef STACK_SIZE
 #define STACK_SIZE  4096
+#endif
 
 #define NUM_THREADS	4		// number of threads
+#ifndef TOTAL_TIME          // bench.sh may override TOTAL_TIME, POLL_PRIO, BUDGET, ARR_TIME, REQ_LOOP, ARR_MODE, ARR_SEED, SERVER, NUM_SERVERS, DRAIN_TIME, REQ_BATCH, REQ_ORDER, REQ_DEADLINE, REQ_ADMIT, TASK_WORKLOAD, REQ_WORKLOAD and LOOP_UNIT_US per build
 #define TOTAL_TIME 6000  	// total execution time in milliseconds
-#define MAX_RECORD 200
+#endif
+#define MAX_RECORD 200      // requests whose response time is recorded, see reqstats.h
+#ifndef DRAIN_TIME
+#define DRAIN_TIME 500      // ms the servers go on serving queued requests after the run, the rest is cancelled
+#endif
+#ifndef REQ_CSV
+#define REQ_CSV 0           // 1: print the recorded requests as CSV at the end of the run
+#endif
+
+#ifndef TASK_WORKLOAD
+#define TASK_WORKLOAD WL_ALU    // busy work kernel of the periodic tasks (WL_ALU, WL_MEMORY or WL_CACHE)
+#endif
+#ifndef REQ_WORKLOAD
+#define REQ_WORKLOAD WL_ALU     // busy work kernel of the aperiodic requests
+#endif
+#ifndef LOOP_UNIT_US
+#define LOOP_UNIT_US 0          // 1: loop_iter and REQ_LOOP are execution times in microseconds
+#endif
+
+enum overrun_policy     // reaction of a task to a job past its deadline
+{
+    OVR_CONTINUE,       // finish the job, the next release waits for it
+    OVR_SKIP,           // finish the job and drop the next release
+    OVR_ABORT,          // stop the job
+    OVR_DEMOTE,         // finish the job at DEMOTE_PRIO
+    OVR_DEGRADE,        // run the next DEGRADE_JOBS jobs with DEGRADE_PERCENT of their iterations
+    OVR_POLICIES
+};
+
+#define OVERRUN_POLICY_NAMES {"continue", "skip", "abort", "demote", "degrade"}
+
+#define DEMOTE_PRIO 13          // priority of a demoted job, below all tasks and the polling server
+#define DEGRADE_JOBS 4          // jobs run in degraded mode after a miss
+#define DEGRADE_PERCENT 50      // share of the iterations done by a degraded job
 
 struct task_s           // struct for periodic task
 {
@@ -29,107 +68,191 @@ struct task_s           // struct for periodic task
 	int priority; 		// priority of the task
 	int period; 		// period for periodic task in milliseconds
 	int loop_iter; 	   // loop iterations for compute
+	int overrun;        // overrun policy (enum overrun_policy)
 };
 
-#define THREAD0 {"task00", 5, 50, 1680000}
-#define THREAD1 {"task11", 8, 160, 3500000}
-#define THREAD2 {"task22", 9, 220, 3640000}
-#define THREAD3 {"task33", 10, 360, 3640000}
+#define THREAD0 {"task00", 5, 50, 1680000, OVR_CONTINUE}
+#define THREAD1 {"task11", 8, 160, 3500000, OVR_CONTINUE}
+#define THREAD2 {"task22", 9, 220, 3640000, OVR_CONTINUE}
+#define THREAD3 {"task33", 10, 360, 3640000, OVR_CONTINUE}
 
-struct task_s threads[NUM_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
-
-struct task_aps         // struct for polling server
+struct task_aps         // struct for an aperiodic server and its request class
 {
 	char t_name[32]; 	// task name
 	int priority; 		// assigned priority of the task
 	int period; 		// replenishment period for polling task in milliseconds
 	int budget; 		// budget of polling task in milliseconds
+	int kind;           // server algorithm (enum server_kind)
+	int weight;         // share of the arrivals that are requests of this server
+	int req_loop;       // loop count of its requests
 	k_tid_t poll_tid;   // thread id for the polling server
-	uint32_t last_switched_in;     
+	uint32_t last_switched_in;     // cycle count when the server last started charging its budget
 	int left_budget;		// remaining budget in nanoseconds
 };
 
+#ifndef POLL_PRIO
 #define POLL_PRIO 6   // > 10 for background server only.
+#endif
+#ifndef BUDGET
 #define BUDGET 40       // execution budget for polling server in milliseconds
                         // an alternate budget is 25
+#endif
 
-struct task_aps poll_info = {"polling_t", POLL_PRIO, 120, BUDGET, NULL, 0, 1000000*BUDGET};
+#define BG_PRIO 14      // priority of the server without budget (background service), above the trace drain thread
+#define SLACK_PRIO 4    // priority of the slack stealing server with slack, above all tasks
 
-struct req_type {       // struct for aperiodic requests
-    uint32_t id;
-    uint32_t iterations;    // loop iterations for compute
-    uint32_t arr_time;      // the arrival time of the request
+#ifndef NUM_SERVERS
+#define NUM_SERVERS 1   // aperiodic servers started, the first NUM_SERVERS of APS0, APS1
+#endif
+#define APS_SERVERS 2   // servers in the table
+
+enum server_kind        // aperiodic server algorithm, see server.h
+{
+    SERVER_POLLING,     // budget lost when the queue is empty at the poll
+    SERVER_DEFERRABLE,  // budget kept while idle, full replenishment every period
+    SERVER_SPORADIC,    // consumed budget comes back one period after the consumption started
+    SERVER_TBS,         // total bandwidth: each request gets its own budget at the rate BUDGET/period
+    SERVER_SLACK,       // slack stealing: above all tasks while the precomputed slack lasts
+    SERVER_KINDS
 };
 
-static void req_expiry_function(struct k_timer *timer_exp);
+#define SERVER_NAMES {"polling", "deferrable", "sporadic", "tbs", "slack"}
 
-K_MSGQ_DEFINE(req_msgq, sizeof(struct req_type), 20, 4);
-K_TIMER_DEFINE(req_timer, req_expiry_function, NULL);
+#ifndef SERVER
+#define SERVER SERVER_POLLING
+#endif
 
-// variance to generate random numbers
-#define VAR_R    0
-#define VAR_A    0.4
-#define VAR_L    0.5
+#ifndef REQ_BATCH
+#define REQ_BATCH 0     // > 0: requests served per server activation at most, only while they fit in the budget
+#endif
 
-// Loop to emulate task execution
-void looping(int loop_count) 
+enum req_order          // order in which queued requests are served, see reqq.h
 {
-    volatile int t1 = loop_count;
+    REQ_FIFO,           // arrival
+    REQ_SJF,            // fewest iterations first
+    REQ_EDF,            // earliest soft deadline first
+    REQ_ORDERS
+};
 
-    while (t1 > 0) t1--;
-    compiler_barrier();
-}
+#define REQ_ORDER_NAMES {"fifo", "sjf", "edf"}
+
+#ifndef REQ_ORDER
+#define REQ_ORDER REQ_FIFO
+#endif
+#ifndef REQ_DEADLINE
+#define REQ_DEADLINE 200000     // soft relative deadline of a request in microseconds
+#endif
+#ifndef REQ_ADMIT
+#define REQ_ADMIT 0     // 1: reject requests that cannot end before their soft deadline
+#endif
 
-// generate random number between base*(1-var) and base
-static uint32_t rand_dist(int base, float var)  
+#ifndef ARR_TIME
+#define ARR_TIME 40000      // interarrival time of aperiodic requests in microseconds 150000
+#endif
+#ifndef REQ_LOOP
+#define REQ_LOOP 1250000     // aperiodic request loop count 420000
+#endif
+
+enum arr_mode           // arrival process of the aperiodic requests, see arrivals.h
 {
-    int iter;
-    int range;
+    ARR_UNIFORM,        // interarrival times uniform between (100 - ARR_VAR)% of ARR_TIME and ARR_TIME
+    ARR_POISSON,        // exponential interarrival times of mean ARR_TIME
+    ARR_BURSTY,         // Markov-modulated Poisson: calm periods at ARR_TIME, bursts ARR_BURST_RATE times faster
+    ARR_TRACE,          // replay of the recorded arrivals in arrival_trace.h
+    ARR_MODES
+};
 
-    range = base*var;
-    iter = base; 
-    if (range > 0) {
-        iter = iter * (1-var) + rand() % range;
-    }
-    return iter;
+#define ARR_MODE_NAMES {"uniform", "poisson", "bursty", "trace"}
 
-}
+#ifndef ARR_MODE
+#define ARR_MODE ARR_UNIFORM
+#endif
+#ifndef ARR_SEED
+#define ARR_SEED 1          // seed of the arrival generator, the same seed gives the same schedule
+#endif
+#define ARR_VAR 40          // ARR_UNIFORM: spread of the interarrival times in percent of ARR_TIME
+#define REQ_VAR 0           // spread of the request loop counts in percent of REQ_LOOP
+#define ARR_BURST_RATE 8    // ARR_BURSTY: arrival rate in a burst, times the calm rate
+#define ARR_BURST_MS 200    // ARR_BURSTY: mean length of a burst
+#define ARR_CALM_MS 1500    // ARR_BURSTY: mean time between bursts
 
-// end-start, if end < start, add overflow
-uint64_t sub32(uint32_t start, uint32_t end)  
+struct req_type {       // struct for aperiodic requests
+    uint32_t id;
+    uint8_t cls;            // request class, the index of the server that serves it
+    uint32_t iterations;    // loop iterations for compute
+    uint32_t arr_time;      // the arrival time of the request
+    uint32_t deadline;      // soft deadline, cycle count
+    int64_t arr_ticks;      // the arrival time in ticks, for response times past the cycle counter wrap
+};
+
+// end-start, if end < start, add overflow (equal means no time passed)
+static inline uint64_t sub32(uint32_t start, uint32_t end)  
 {  
     uint64_t a, b;
 
     a = (uint64_t) start;
     b = (uint64_t) end;
 
-    if (b>a) 
+    if (b>=a) 
             return (b-a);
     else {
         return ((b + (((uint64_t) 1)<<32)) -a);
     }
 }
 
-#define ARR_TIME 40000      // interarrival time of aperiodic requests in microseconds 150000
-#define REQ_LOOP 1250000     // aperiodic request loop count 420000
+#ifndef TASK_MODEL_TYPES_ONLY      // server.c and reqq.c only need the types and sub32 above
+
+#include "reqq.h"
+#include "arrivals.h"
+
+struct task_s threads[NUM_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
+
+// every server serves its own request class from its own queue
+#define APS0 {"polling_t", POLL_PRIO, 120, BUDGET, SERVER, 3, REQ_LOOP, NULL, 0, 1000000*BUDGET}
+#define APS1 {"sporadic_t", 7, 200, 20, SERVER_SPORADIC, 1, 420000, NULL, 0, 1000000*20}
+
+struct task_aps poll_info[APS_SERVERS] = {APS0, APS1};
+
+static void req_expiry_function(struct k_timer *timer_exp);
+
+struct reqq req_queue[NUM_SERVERS];     // set up by main() with reqq_init(), one per request class
+K_TIMER_DEFINE(req_timer, req_expiry_function, NULL);
+
+// Loop to emulate task execution, calibrated by workload_init()
+void looping(enum workload_kind kind, uint32_t loop_count) 
+{
+#if LOOP_UNIT_US
+    workload_run_us(kind, loop_count);
+#else
+    workload_run(kind, loop_count);
+#endif
+    compiler_barrier();
+}
+
 int total_req=0;
 
-// Timer allback function to generate aperiodic requests
+// Timer allback function to generate aperiodic requests, from the schedule arrivals_init() built before the run
 static void req_expiry_function(struct k_timer *timer_exp)
 {
-    uint32_t stime;
+    const struct arrival *a = arrivals_get(total_req);
     struct req_type data;
 
     data.id = total_req;
-    data.iterations = rand_dist(REQ_LOOP, VAR_R);
+    data.cls = a->cls;
+    data.iterations = a->iterations;
     data.arr_time = k_cycle_get_32();
-    k_msgq_put(&req_msgq, &data, K_NO_WAIT);
+    data.arr_ticks = k_uptime_ticks();
+    data.deadline = data.arr_time + (uint32_t)k_us_to_cyc_ceil64(REQ_DEADLINE);
+    if (reqq_put(&req_queue[data.cls], &data) == 0) {     //dropped and rejected requests are counted by the queue
+        evtrace_log(EVT_REQ_ARRIVAL, EVT_NO_THREAD, data.id);
+    }
     
     total_req++;
 
-    stime = rand_dist(ARR_TIME, VAR_A);
-    k_timer_start(&req_timer, K_USEC(stime), K_NO_WAIT);
+    k_timer_start(&req_timer, K_USEC(arrivals_get(total_req)->gap_us), K_NO_WAIT);
 
 }
 
+#endif // TASK_MODEL_TYPES_ONLY
+
 #endif // __TASK_MODEL_H__
\ No newline at end of file
@@ -0,0 +1,187 @@
+/*
+ * Lock-free event trace: many producers (threads, timer callbacks, ISRs),
+ * one consumer (the drain thread).
+ *
+ * A producer reserves slot head with a compare-and-swap and commits it by
+ * writing seq = head + 1 last. The drain thread only reads a slot once its
+ * seq matches, and a slot is not reserved again before the drain thread has
+ * moved the tail past it. When the ring is full, new events are dropped and
+ * counted rather than overwriting records that were not drained.
+ */
+
+#include <zephyr.h>
+#include <sys/printk.h>
+#include <shell/shell.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evtrace.h"
+
+#define EVT_DRAIN_STACK_SIZE 1024
+#ifndef EVT_DRAIN_PRIO
+#define EVT_DRAIN_PRIO K_LOWEST_APPLICATION_THREAD_PRIO	// drains in the slack of the measured tasks
+#endif
+#define EVT_DRAIN_PERIOD_MS 100
+
+#define evt_barrier() __asm__ __volatile__ ("" ::: "memory")
+
+BUILD_ASSERT(IS_POWER_OF_TWO(EVT_BUF_RECORDS), "EVT_BUF_RECORDS must be a power of two");
+
+static struct evt_record evt_buf[EVT_BUF_RECORDS];
+static atomic_t evt_head;		// next slot to reserve
+static atomic_t evt_tail;		// next slot to drain, only moved by the drain thread
+static atomic_t evt_dropped;		// events lost on a full ring
+static bool evt_stream;			// print every drained record
+static const char *evt_thread_names[EVT_MAX_THREADS];
+
+#define EVT_NAME(name) #name,
+
+static const char * const evt_names[EVT_COUNT] = { EVT_LIST(EVT_NAME) };
+
+void evtrace_log(enum evt_id event, uint8_t thread, uint32_t arg)
+{
+	atomic_val_t head;
+	struct evt_record *rec;
+
+	do
+	{
+		head = atomic_get(&evt_head);
+		if ((uint32_t)(head - atomic_get(&evt_tail)) >= EVT_BUF_RECORDS)
+		{
+			atomic_inc(&evt_dropped);
+			return;
+		}
+	} while (!atomic_cas(&evt_head, head, head + 1));
+
+	rec = &evt_buf[head & (EVT_BUF_RECORDS - 1)];
+	rec->timestamp = k_cycle_get_32();
+	rec->event = event;
+	rec->thread = thread;
+	rec->arg = arg;
+	evt_barrier();
+	rec->seq = (uint32_t)head + 1;		// commit
+}
+
+void evtrace_name_set(uint8_t thread, const char *name)
+{
+	if (thread < EVT_MAX_THREADS)
+	{
+		evt_thread_names[thread] = name;
+	}
+}
+
+static const char *thread_name(uint8_t thread)
+{
+	if (thread < EVT_MAX_THREADS && evt_thread_names[thread])
+	{
+		return evt_thread_names[thread];
+	}
+
+	return "?";
+}
+
+static void print_header(void)		// what tools/evdecode needs besides the records
+{
+	printk("EVTHZ %u\n", (uint32_t)sys_clock_hw_cycles_per_sec());
+
+	for (int i = 0; i < EVT_MAX_THREADS; i++)
+	{
+		if (evt_thread_names[i])
+		{
+			printk("EVTNAME %d %s\n", i, evt_thread_names[i]);
+		}
+	}
+}
+
+static void print_record(const struct evt_record *rec)
+{
+	if (evt_stream)
+	{
+		printk("EVT %08x %04x %02x %08x\n", rec->timestamp, rec->event, rec->thread, rec->arg);
+	}
+
+	if (rec->event == EVT_DEADLINE_MISS)
+	{
+		printk("Deadline is missed by %s (job %u)\n", thread_name(rec->thread), rec->arg);
+	}
+}
+
+static void evtrace_drain(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (1)
+	{
+		atomic_val_t tail = atomic_get(&evt_tail);
+
+		while (tail != atomic_get(&evt_head))
+		{
+			struct evt_record *slot = &evt_buf[tail & (EVT_BUF_RECORDS - 1)];
+			struct evt_record rec;
+
+			if (slot->seq != (uint32_t)tail + 1)
+			{
+				break;		// reserved but not committed yet
+			}
+			evt_barrier();
+			rec = *slot;
+
+			tail++;
+			atomic_set(&evt_tail, tail);	// the slot may be reused from here on
+
+			print_record(&rec);
+		}
+
+		k_msleep(EVT_DRAIN_PERIOD_MS);
+	}
+}
+
+K_THREAD_DEFINE(evtrace_drain_tid, EVT_DRAIN_STACK_SIZE, evtrace_drain, NULL, NULL, NULL,
+		EVT_DRAIN_PRIO, 0, 0);
+
+
+static int trace_stream(const struct shell *shell, size_t argc, char **argv)
+{
+	if (strcmp(argv[1], "on") == 0)
+	{
+		print_header();
+		evt_stream = true;
+	}
+	else if (strcmp(argv[1], "off") == 0)
+	{
+		evt_stream = false;
+	}
+	else
+	{
+		shell_error(shell, "Expected on or off");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int trace_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(shell, "logged %u, drained %u, dropped %u, ring %d records",
+		    (uint32_t)atomic_get(&evt_head), (uint32_t)atomic_get(&evt_tail),
+		    (uint32_t)atomic_get(&evt_dropped), EVT_BUF_RECORDS);
+
+	for (int i = 0; i < EVT_COUNT; i++)
+	{
+		shell_print(shell, "%04x %s", i, evt_names[i]);
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(trace_cmds,
+	SHELL_CMD_ARG(stream, NULL, "Print every trace record for tools/evdecode: <on|off>", trace_stream, 2, 0),
+	SHELL_CMD(stats, NULL, "Print the trace counters and event ids", trace_stats),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(trace, &trace_cmds, "Event trace", NULL);
@@ -0,0 +1,68 @@
+#ifndef __EVTRACE_H__
+#define __EVTRACE_H__
+
+/*
+ * Lock-free event trace.
+ *
+ * Fixed size binary records are reserved with a compare-and-swap on the
+ * write index, so timer callbacks, ISRs and threads can log without locks
+ * and without printk. A drain thread at the lowest priority empties the
+ * buffer; it prints deadline misses and, with "trace stream on", every
+ * record as an "EVT" line for tools/evdecode of trace_app.
+ *
+ * The record layout and the event list are shared with the host decoder.
+ */
+
+#include <stdint.h>
+
+#ifndef EVT_BUF_RECORDS
+#define EVT_BUF_RECORDS 1024		// records in the ring, must be a power of two
+#endif
+#define EVT_MAX_THREADS 16		// thread ids with a registered name
+#define EVT_NO_THREAD 0xff		// record not related to a thread
+
+#define EVT_LIST(X) \
+	X(RUN_START)		/* arg: run length in ms */ \
+	X(RUN_END)		/* arg: unused */ \
+	X(RELEASE)		/* arg: job number */ \
+	X(JOB_START)		/* arg: release to start delay in us */ \
+	X(JOB_END)		/* arg: response time in us */ \
+	X(DEADLINE_MISS)	/* arg: job number */ \
+	X(DEADLINE_MET)		/* arg: job number */ \
+	X(LOCK)			/* arg: mutex id */ \
+	X(UNLOCK)		/* arg: mutex id */ \
+	X(SUSPEND)		/* arg: unused */ \
+	X(REQ_ARRIVAL)		/* arg: request id */ \
+	X(REQ_START)		/* arg: request id */ \
+	X(REQ_DONE)		/* arg: request id */ \
+	X(BUDGET_EXHAUSTED)	/* arg: unused */ \
+	X(BUDGET_REPLENISH)	/* arg: budget in us */ \
+	X(OVERRUN)		/* arg: overrun policy */ \
+	X(JOB_ABORT)		/* arg: job number */
+
+#define EVT_ENUM(name) EVT_##name,
+
+enum evt_id
+{
+	EVT_LIST(EVT_ENUM)
+	EVT_COUNT
+};
+
+struct evt_record
+{
+	uint32_t timestamp;	// k_cycle_get_32() when the event was logged
+	uint16_t event;		// enum evt_id
+	uint8_t thread;		// task index, EVT_NO_THREAD when none
+	uint8_t reserved;
+	uint32_t arg;		// event argument, see EVT_LIST
+	uint32_t seq;		// reservation number + 1, written last to commit the record
+};
+
+#ifdef __ZEPHYR__
+
+void evtrace_log(enum evt_id event, uint8_t thread, uint32_t arg);
+void evtrace_name_set(uint8_t thread, const char *name);
+
+#endif // __ZEPHYR__
+
+#endif // __EVTRACE_H__
@@ -0,0 +1,195 @@
+/*
+ * Calibrated busy work kernels.
+ *
+ * The memory kernels share their buffers between all tasks. Concurrent
+ * jobs only race on the buffer contents and positions, which is harmless
+ * for busy work and adds the interference we want to study.
+ *
+ * native_posix runs code in zero simulated time, so there the kernels are
+ * replaced by k_busy_wait() at WL_POSIX_ITER_PER_MS, which also makes the
+ * benchmark runs of bench.sh deterministic; the kernels and their buffers
+ * are not built there.
+ */
+
+#include <string.h>
+#include "workload.h"
+
+#define WL_WORDS (WORKLOAD_BUF_SIZE / sizeof(uint32_t))
+#define WL_LINE_WORDS (WORKLOAD_LINE_SIZE / sizeof(uint32_t))
+#define WL_LINES (WORKLOAD_BUF_SIZE / WORKLOAD_LINE_SIZE)
+#define WL_CALIB_ITER 100000		// iterations timed per calibration run
+#define WL_CALIB_RUNS 3			// the fastest run is kept, it is the one least disturbed by interrupts
+#define WL_POSIX_ITER_PER_MS 50000	// nominal speed of every kernel on native_posix
+
+#ifndef CONFIG_ARCH_POSIX
+
+BUILD_ASSERT(IS_POWER_OF_TWO(WL_WORDS), "WORKLOAD_BUF_SIZE must be a power of two");
+
+static uint32_t stream_buf[WL_WORDS];		// buffer of the streaming kernel
+static uint32_t chase_buf[WL_WORDS];		// first word of every line holds the index of the next line
+static uint32_t stream_pos;			// next word of the streaming kernel
+static uint32_t chase_line;			// current line of the pointer chase
+
+static void run_alu(uint32_t iterations)
+{
+	volatile workload_count_t n = iterations;
+
+	while (n > 0)
+	{
+		n--;
+	}
+}
+
+static void run_memory(uint32_t iterations)
+{
+	volatile uint32_t *buf = stream_buf;
+	uint32_t pos = stream_pos;
+
+	while (iterations--)
+	{
+		buf[pos]++;
+		pos = (pos + 1) & (WL_WORDS - 1);
+	}
+
+	stream_pos = pos;
+}
+
+static void run_cache(uint32_t iterations)
+{
+	volatile uint32_t *buf = chase_buf;
+	uint32_t line = chase_line;
+
+	while (iterations--)
+	{
+		line = buf[line * WL_LINE_WORDS];	// the address depends on the previous load, so misses do not overlap
+	}
+
+	chase_line = line;
+}
+
+static void build_chase(void)		// Sattolo's shuffle: one random cycle through all lines
+{
+	uint32_t seed = 2463534242U;
+
+	for (uint32_t i = 0; i < WL_LINES; i++)
+	{
+		chase_buf[i * WL_LINE_WORDS] = i;
+	}
+
+	for (uint32_t i = WL_LINES - 1; i > 0; i--)
+	{
+		uint32_t j, tmp;
+
+		seed ^= seed << 13;		// xorshift32
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		j = seed % i;
+
+		tmp = chase_buf[i * WL_LINE_WORDS];
+		chase_buf[i * WL_LINE_WORDS] = chase_buf[j * WL_LINE_WORDS];
+		chase_buf[j * WL_LINE_WORDS] = tmp;
+	}
+
+	chase_line = 0;
+}
+
+#endif // CONFIG_ARCH_POSIX
+
+static uint32_t cyc_per_kiter[WL_KINDS];	// calibrated cycles per 1024 iterations
+
+static const char * const kind_names[WL_KINDS] = {"alu", "mem", "cache"};
+
+void workload_run(enum workload_kind kind, uint32_t iterations)
+{
+#ifdef CONFIG_ARCH_POSIX
+	ARG_UNUSED(kind);
+	k_busy_wait((uint32_t)((uint64_t)iterations * 1000U / WL_POSIX_ITER_PER_MS));
+#else
+	switch (kind)
+	{
+	case WL_MEMORY:
+		run_memory(iterations);
+		break;
+	case WL_CACHE:
+		run_cache(iterations);
+		break;
+	default:
+		run_alu(iterations);
+		break;
+	}
+#endif
+}
+
+void workload_run_us(enum workload_kind kind, uint32_t us)
+{
+	uint64_t iterations;
+
+	if (kind >= WL_KINDS || cyc_per_kiter[kind] == 0)
+	{
+		kind = WL_ALU;
+	}
+
+	iterations = k_us_to_cyc_floor64(us) * 1024U / cyc_per_kiter[kind];
+	workload_run(kind, iterations > UINT32_MAX ? UINT32_MAX : (uint32_t)iterations);
+}
+
+uint32_t workload_iter_per_ms(enum workload_kind kind)
+{
+	if (kind >= WL_KINDS || cyc_per_kiter[kind] == 0)
+	{
+		return 0;
+	}
+
+	return (uint32_t)(k_ms_to_cyc_ceil64(1) * 1024U / cyc_per_kiter[kind]);
+}
+
+const char *workload_name(enum workload_kind kind)
+{
+	return kind < WL_KINDS ? kind_names[kind] : "?";
+}
+
+int workload_parse(const char *name)
+{
+	for (int kind = 0; kind < WL_KINDS; kind++)
+	{
+		if (strcmp(name, kind_names[kind]) == 0)
+		{
+			return kind;
+		}
+	}
+
+	return -EINVAL;
+}
+
+void workload_init(void)		// builds the pointer chase and times every kernel
+{
+#ifndef CONFIG_ARCH_POSIX
+	build_chase();
+	memset(stream_buf, 0, sizeof(stream_buf));
+#endif
+
+	for (int kind = 0; kind < WL_KINDS; kind++)
+	{
+		uint32_t best = UINT32_MAX;
+
+		for (int run = 0; run < WL_CALIB_RUNS; run++)
+		{
+			uint32_t start = k_cycle_get_32();
+
+			workload_run(kind, WL_CALIB_ITER);
+
+			uint32_t cyc = k_cycle_get_32() - start;
+
+			if (cyc < best)
+			{
+				best = cyc;
+			}
+		}
+
+		cyc_per_kiter[kind] = (uint32_t)(((uint64_t)best * 1024U) / WL_CALIB_ITER);
+		if (cyc_per_kiter[kind] == 0)
+		{
+			cyc_per_kiter[kind] = 1;
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+/*
+ * Calibrated busy work for the periodic tasks.
+ *
+ * Every kernel is timed at boot with k_cycle_get_32(), so a job can be
+ * given either as a number of iterations or as an execution time in
+ * microseconds, whatever the compiler flags, caches and board are.
+ */
+
+#include <zephyr.h>
+
+#ifndef WORKLOAD_BUF_SIZE			// boards with little RAM set a smaller size in the CMakeLists.txt of the app
+#define WORKLOAD_BUF_SIZE (64 * 1024)	// bytes per kernel buffer, larger than the 32 KB L1 D-cache of the i.MX RT1050
+#endif
+#define WORKLOAD_LINE_SIZE 32		// cache line size in bytes
+
+#ifndef WORKLOAD_COUNT_TYPE
+#define WORKLOAD_COUNT_TYPE uint32_t	// the CMakeLists.txt of an app sets the width its iteration counts were tuned with
+#endif
+
+typedef WORKLOAD_COUNT_TYPE workload_count_t;	// counter of the ALU kernel
+
+enum workload_kind
+{
+	WL_ALU,			// register countdown, no memory traffic
+	WL_MEMORY,		// sequential read-modify-write streaming through a buffer
+	WL_CACHE,		// dependent loads chasing a random cycle of cache lines, a miss per iteration
+	WL_KINDS
+};
+
+void workload_init(void);
+void workload_run(enum workload_kind kind, uint32_t iterations);
+void workload_run_us(enum workload_kind kind, uint32_t us);
+uint32_t workload_iter_per_ms(enum workload_kind kind);
+const char *workload_name(enum workload_kind kind);
+int workload_parse(const char *name);
+
+#endif // __WORKLOAD_H__